@@ -1,35 +1,19 @@
 #include "ast_builder.h"
 #include <memory>
+#include "number.h"
 
 antlrcpp::Any ASTBuilder::visitFile(LoxParser::FileContext *ctx)
 {
     for (auto &d : ctx->declaration()) {
-        statements.push_back(visit(d).as<std::shared_ptr<Stmt>>());
+        statements.push_back(build_stmt(d));
     }
     return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitFunctionDecl(LoxParser::FunctionDeclContext *ctx)
 {
-    auto fn = visitFunction(ctx->function()).as<std::shared_ptr<Function>>();
-    return std::static_pointer_cast<Stmt>(fn);
-}
-
-antlrcpp::Any ASTBuilder::visitFunction(LoxParser::FunctionContext *ctx)
-{
-    auto *name = ctx->IDENTIFIER()->getSymbol();
-
-    std::vector<antlr4::Token *> params;
-    if (ctx->parameters()) {
-        auto formal_params = ctx->parameters()->IDENTIFIER();
-        for (size_t i = 0; i < formal_params.size(); ++i) {
-            params.push_back(formal_params[i]->getSymbol());
-        }
-    }
-
-    auto block = visitBlock(ctx->block());
-    auto block_expr = block.as<std::shared_ptr<Stmt>>();
-    return std::make_shared<Function>(name, params, block_expr);
+    stmt_result = function(ctx->function());
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitClassDecl(LoxParser::ClassDeclContext *ctx)
@@ -37,47 +21,37 @@ antlrcpp::Any ASTBuilder::visitClassDecl(LoxParser::ClassDeclContext *ctx)
     auto *name = ctx->IDENTIFIER()->getSymbol();
     std::vector<std::shared_ptr<Function>> methods;
     for (auto &f : ctx->function()) {
-        methods.push_back(visitFunction(f).as<std::shared_ptr<Function>>());
+        methods.push_back(function(f));
     }
-    auto c = std::make_shared<Class>(name, methods);
-    return std::static_pointer_cast<Stmt>(c);
+    stmt_result = std::make_shared<Class>(name, methods);
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitVarDeclStmt(LoxParser::VarDeclStmtContext *ctx)
 {
-    return visit(ctx->varDecl());
-}
-
-antlrcpp::Any ASTBuilder::visitVarDecl(LoxParser::VarDeclContext *ctx)
-{
-    auto *name = ctx->IDENTIFIER()->getSymbol();
-    std::shared_ptr<Expr> initializer;
-    if (ctx->expr()) {
-        initializer = visit(ctx->expr()).as<std::shared_ptr<Expr>>();
-    }
-    auto vardecl = std::make_shared<Var>(name, initializer);
-    return std::static_pointer_cast<Stmt>(vardecl);
+    stmt_result = var_decl(ctx->varDecl());
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitIfStmt(LoxParser::IfStmtContext *ctx)
 {
-    auto condition = visit(ctx->expr()).as<std::shared_ptr<Expr>>();
-    auto then_branch = visit(ctx->statement(0)).as<std::shared_ptr<Stmt>>();
+    auto condition = build_expr(ctx->expr());
+    auto then_branch = build_stmt(ctx->statement(0));
 
     std::shared_ptr<Stmt> else_branch;
     if (ctx->ELSE()) {
-        else_branch = visit(ctx->statement(1)).as<std::shared_ptr<Stmt>>();
+        else_branch = build_stmt(ctx->statement(1));
     }
-    auto if_stmt = std::make_shared<If>(condition, then_branch, else_branch);
-    return std::static_pointer_cast<Stmt>(if_stmt);
+    stmt_result = std::make_shared<If>(condition, then_branch, else_branch);
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitWhileStmt(LoxParser::WhileStmtContext *ctx)
 {
-    auto condition = visit(ctx->expr()).as<std::shared_ptr<Expr>>();
-    auto body = visit(ctx->statement()).as<std::shared_ptr<Stmt>>();
-    auto while_stmt = std::make_shared<While>(condition, body);
-    return std::static_pointer_cast<Stmt>(while_stmt);
+    auto condition = build_expr(ctx->expr());
+    auto body = build_stmt(ctx->statement());
+    stmt_result = std::make_shared<While>(condition, body);
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitForStmt(LoxParser::ForStmtContext *ctx)
@@ -85,23 +59,23 @@ antlrcpp::Any ASTBuilder::visitForStmt(LoxParser::ForStmtContext *ctx)
     // Convert the for syntax sugar to a while statement in the AST
     std::shared_ptr<Stmt> initializer;
     if (ctx->varDecl()) {
-        initializer = visitVarDecl(ctx->varDecl()).as<std::shared_ptr<Stmt>>();
+        initializer = var_decl(ctx->varDecl());
     } else if (ctx->forInit()) {
-        auto expr = visit(ctx->forInit()->expr()).as<std::shared_ptr<Expr>>();
+        auto expr = build_expr(ctx->forInit()->expr());
         initializer = std::make_shared<Expression>(expr);
     }
 
     std::shared_ptr<Expr> condition;
     if (ctx->forCond()) {
-        condition = visit(ctx->forCond()->expr()).as<std::shared_ptr<Expr>>();
+        condition = build_expr(ctx->forCond()->expr());
     } else {
         condition = std::make_shared<Literal>(true);
     }
 
-    auto body = visit(ctx->statement()).as<std::shared_ptr<Stmt>>();
+    auto body = build_stmt(ctx->statement());
 
     if (ctx->forAdvance()) {
-        auto expr = visit(ctx->forAdvance()->expr()).as<std::shared_ptr<Expr>>();
+        auto expr = build_expr(ctx->forAdvance()->expr());
         auto advance = std::make_shared<Expression>(expr);
 
         body = std::make_shared<Block>(std::vector<std::shared_ptr<Stmt>>{body, advance});
@@ -112,185 +86,119 @@ antlrcpp::Any ASTBuilder::visitForStmt(LoxParser::ForStmtContext *ctx)
         body = std::make_shared<Block>(std::vector<std::shared_ptr<Stmt>>{initializer, body});
     }
 
-    return std::static_pointer_cast<Stmt>(body);
+    stmt_result = body;
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitPrintStmt(LoxParser::PrintStmtContext *ctx)
 {
-    auto expr = visit(ctx->expr()).as<std::shared_ptr<Expr>>();
-    auto print = std::make_shared<Print>(expr);
-    return std::static_pointer_cast<Stmt>(print);
+    stmt_result = std::make_shared<Print>(build_expr(ctx->expr()));
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitReturnStmt(LoxParser::ReturnStmtContext *ctx)
 {
-    auto expr = visit(ctx->expr()).as<std::shared_ptr<Expr>>();
-    auto ret = std::make_shared<Return>(ctx->RETURN()->getSymbol(), expr);
-    return std::static_pointer_cast<Stmt>(ret);
+    auto expr = build_expr(ctx->expr());
+    stmt_result = std::make_shared<Return>(ctx->RETURN()->getSymbol(), expr);
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitBlock(LoxParser::BlockContext *ctx)
 {
-    std::vector<std::shared_ptr<Stmt>> block_stmts;
-    for (auto &d : ctx->declaration()) {
-        block_stmts.push_back(visit(d).as<std::shared_ptr<Stmt>>());
-    }
-
-    auto block = std::make_shared<Block>(block_stmts);
-    return std::static_pointer_cast<Stmt>(block);
+    stmt_result = block(ctx);
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitExprStmt(LoxParser::ExprStmtContext *ctx)
 {
-    auto expr = visit(ctx->expr()).as<std::shared_ptr<Expr>>();
-    auto expr_stmt = std::make_shared<Expression>(expr);
-    return std::static_pointer_cast<Stmt>(expr_stmt);
+    stmt_result = std::make_shared<Expression>(build_expr(ctx->expr()));
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitUnary(LoxParser::UnaryContext *ctx)
 {
     auto *op = ctx->MINUS() ? ctx->MINUS()->getSymbol() : ctx->BANG()->getSymbol();
-    auto expr = visit(ctx->expr()).as<std::shared_ptr<Expr>>();
-    auto unary = std::make_shared<Unary>(op, expr);
-    return std::static_pointer_cast<Expr>(unary);
-}
-
-antlrcpp::Any ASTBuilder::visitCallExpr(LoxParser::CallExprContext *ctx)
-{
-    std::shared_ptr<Expr> expr = std::make_shared<Variable>(ctx->IDENTIFIER()->getSymbol());
-    for (size_t i = 1; i < ctx->children.size(); ++i) {
-        auto child = ctx->children[i];
-        auto res = visit(child);
-        // The terminal node/tokens will not return a value
-        if (res.isNotNull()) {
-            if (res.is<std::vector<std::shared_ptr<Expr>>>()) {
-                auto paren = dynamic_cast<antlr4::tree::TerminalNode *>(ctx->children[i - 1]);
-                expr = std::make_shared<Call>(
-                    expr, paren->getSymbol(), res.as<std::vector<std::shared_ptr<Expr>>>());
-            } else if (res.is<antlr4::Token *>()) {
-                auto *name = res.as<antlr4::Token *>();
-                expr = std::make_shared<Get>(expr, name);
-            }
-        }
-    }
-    return expr;
-}
-
-antlrcpp::Any ASTBuilder::visitArguments(LoxParser::ArgumentsContext *ctx)
-{
-    std::vector<std::shared_ptr<Expr>> args;
-    for (auto &e : ctx->expr()) {
-        args.push_back(visit(e).as<std::shared_ptr<Expr>>());
-    }
-    return args;
+    expr_result = std::make_shared<Unary>(op, build_expr(ctx->expr()));
+    return antlrcpp::Any();
 }
 
-antlrcpp::Any ASTBuilder::visitMemberIdentifier(LoxParser::MemberIdentifierContext *ctx)
+antlrcpp::Any ASTBuilder::visitCall(LoxParser::CallContext *ctx)
 {
-    return ctx->IDENTIFIER()->getSymbol();
+    expr_result = call_expr(ctx->callExpr());
+    return antlrcpp::Any();
 }
 
-// void visit(const Binary &b) override;
 antlrcpp::Any ASTBuilder::visitMult(LoxParser::MultContext *ctx)
 {
-    auto left = visit(ctx->children[0]).as<std::shared_ptr<Expr>>();
-    auto right = visit(ctx->children[2]).as<std::shared_ptr<Expr>>();
-    auto mult = std::make_shared<Binary>(left, ctx->STAR()->getSymbol(), right);
-    return std::static_pointer_cast<Expr>(mult);
+    binary(ctx, ctx->STAR()->getSymbol());
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitDiv(LoxParser::DivContext *ctx)
 {
-    auto left = visit(ctx->children[0]).as<std::shared_ptr<Expr>>();
-    auto right = visit(ctx->children[2]).as<std::shared_ptr<Expr>>();
-    auto div = std::make_shared<Binary>(left, ctx->SLASH()->getSymbol(), right);
-    return std::static_pointer_cast<Expr>(div);
+    binary(ctx, ctx->SLASH()->getSymbol());
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitAddSub(LoxParser::AddSubContext *ctx)
 {
-    auto left = visit(ctx->children[0]).as<std::shared_ptr<Expr>>();
-    auto right = visit(ctx->children[2]).as<std::shared_ptr<Expr>>();
-
-    std::shared_ptr<Expr> expr;
-    if (ctx->PLUS()) {
-        expr = std::make_shared<Binary>(left, ctx->PLUS()->getSymbol(), right);
-
-    } else {
-        expr = std::make_shared<Binary>(left, ctx->MINUS()->getSymbol(), right);
-    }
-    return expr;
+    auto *op = ctx->PLUS() ? ctx->PLUS()->getSymbol() : ctx->MINUS()->getSymbol();
+    binary(ctx, op);
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitComparison(LoxParser::ComparisonContext *ctx)
 {
-    auto left = visit(ctx->children[0]).as<std::shared_ptr<Expr>>();
-    auto right = visit(ctx->children[2]).as<std::shared_ptr<Expr>>();
-
-    std::shared_ptr<Expr> expr;
+    antlr4::Token *op = nullptr;
     if (ctx->LESS()) {
-        expr = std::make_shared<Binary>(left, ctx->LESS()->getSymbol(), right);
+        op = ctx->LESS()->getSymbol();
     } else if (ctx->LESS_EQUAL()) {
-        expr = std::make_shared<Binary>(left, ctx->LESS_EQUAL()->getSymbol(), right);
+        op = ctx->LESS_EQUAL()->getSymbol();
     } else if (ctx->GREATER()) {
-        expr = std::make_shared<Binary>(left, ctx->GREATER()->getSymbol(), right);
+        op = ctx->GREATER()->getSymbol();
     } else {
-        expr = std::make_shared<Binary>(left, ctx->GREATER_EQUAL()->getSymbol(), right);
+        op = ctx->GREATER_EQUAL()->getSymbol();
     }
-    return expr;
+    binary(ctx, op);
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitEquality(LoxParser::EqualityContext *ctx)
 {
-    auto left = visit(ctx->children[0]).as<std::shared_ptr<Expr>>();
-    auto right = visit(ctx->children[2]).as<std::shared_ptr<Expr>>();
-
-    std::shared_ptr<Expr> expr;
-    if (ctx->NOT_EQUAL()) {
-        expr = std::make_shared<Binary>(left, ctx->NOT_EQUAL()->getSymbol(), right);
-    } else {
-        expr = std::make_shared<Binary>(left, ctx->EQUAL_EQUAL()->getSymbol(), right);
-    }
-    return expr;
+    auto *op = ctx->NOT_EQUAL() ? ctx->NOT_EQUAL()->getSymbol() : ctx->EQUAL_EQUAL()->getSymbol();
+    binary(ctx, op);
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitLogicAnd(LoxParser::LogicAndContext *ctx)
 {
-    auto left = visit(ctx->children[0]).as<std::shared_ptr<Expr>>();
-    auto right = visit(ctx->children[2]).as<std::shared_ptr<Expr>>();
-
-    auto expr = std::make_shared<Binary>(left, ctx->AND()->getSymbol(), right);
-    return std::static_pointer_cast<Expr>(expr);
+    binary(ctx, ctx->AND()->getSymbol());
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitLogicOr(LoxParser::LogicOrContext *ctx)
 {
-    auto left = visit(ctx->children[0]).as<std::shared_ptr<Expr>>();
-    auto right = visit(ctx->children[2]).as<std::shared_ptr<Expr>>();
-
-    auto expr = std::make_shared<Binary>(left, ctx->OR()->getSymbol(), right);
-    return std::static_pointer_cast<Expr>(expr);
+    binary(ctx, ctx->OR()->getSymbol());
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitAssign(LoxParser::AssignContext *ctx)
 {
-    auto rhs = visit(ctx->expr()).as<std::shared_ptr<Expr>>();
+    auto rhs = build_expr(ctx->expr());
     // If there's a call expr, we're setting a struct member
-    std::shared_ptr<Expr> expr;
     if (ctx->callExpr()) {
-        auto obj = visitCallExpr(ctx->callExpr()).as<std::shared_ptr<Expr>>();
-        expr = std::make_shared<Set>(obj, ctx->IDENTIFIER()->getSymbol(), rhs);
+        auto obj = call_expr(ctx->callExpr());
+        expr_result = std::make_shared<Set>(obj, ctx->IDENTIFIER()->getSymbol(), rhs);
     } else {
-        expr = std::make_shared<Assign>(ctx->IDENTIFIER()->getSymbol(), rhs);
+        expr_result = std::make_shared<Assign>(ctx->IDENTIFIER()->getSymbol(), rhs);
     }
-    return expr;
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitParens(LoxParser::ParensContext *ctx)
 {
-    auto expr = visit(ctx->expr()).as<std::shared_ptr<Expr>>();
-    auto group = std::make_shared<Grouping>(expr);
-    return std::static_pointer_cast<Expr>(group);
+    expr_result = std::make_shared<Grouping>(build_expr(ctx->expr()));
+    return antlrcpp::Any();
 }
 
 antlrcpp::Any ASTBuilder::visitPrimary(LoxParser::PrimaryContext *ctx)
@@ -299,7 +207,7 @@ antlrcpp::Any ASTBuilder::visitPrimary(LoxParser::PrimaryContext *ctx)
     if (ctx->IDENTIFIER()) {
         expr = std::make_shared<Variable>(ctx->IDENTIFIER()->getSymbol());
     } else if (ctx->NUMBER()) {
-        expr = std::make_shared<Literal>(std::stof(ctx->NUMBER()->getText()));
+        expr = std::make_shared<Literal>(parse_number(ctx->NUMBER()->getText()));
     } else if (ctx->STRING()) {
         // Remove the opening and closing quotes
         auto str = ctx->STRING()->getText();
@@ -312,5 +220,86 @@ antlrcpp::Any ASTBuilder::visitPrimary(LoxParser::PrimaryContext *ctx)
     } else if (ctx->NIL()) {
         expr = std::make_shared<Literal>(std::any());
     }
+    expr_result = expr;
+    return antlrcpp::Any();
+}
+
+std::shared_ptr<Stmt> ASTBuilder::build_stmt(antlr4::tree::ParseTree *ctx)
+{
+    stmt_result = nullptr;
+    ctx->accept(this);
+    return std::move(stmt_result);
+}
+
+std::shared_ptr<Expr> ASTBuilder::build_expr(antlr4::tree::ParseTree *ctx)
+{
+    expr_result = nullptr;
+    ctx->accept(this);
+    return std::move(expr_result);
+}
+
+std::shared_ptr<Function> ASTBuilder::function(LoxParser::FunctionContext *ctx)
+{
+    auto *name = ctx->IDENTIFIER()->getSymbol();
+
+    std::vector<antlr4::Token *> params;
+    if (ctx->parameters()) {
+        auto formal_params = ctx->parameters()->IDENTIFIER();
+        for (size_t i = 0; i < formal_params.size(); ++i) {
+            params.push_back(formal_params[i]->getSymbol());
+        }
+    }
+
+    return std::make_shared<Function>(name, params, block(ctx->block()));
+}
+
+std::shared_ptr<Stmt> ASTBuilder::var_decl(LoxParser::VarDeclContext *ctx)
+{
+    auto *name = ctx->IDENTIFIER()->getSymbol();
+    std::shared_ptr<Expr> initializer;
+    if (ctx->expr()) {
+        initializer = build_expr(ctx->expr());
+    }
+    return std::make_shared<Var>(name, initializer);
+}
+
+std::shared_ptr<Stmt> ASTBuilder::block(LoxParser::BlockContext *ctx)
+{
+    std::vector<std::shared_ptr<Stmt>> block_stmts;
+    for (auto &d : ctx->declaration()) {
+        block_stmts.push_back(build_stmt(d));
+    }
+    return std::make_shared<Block>(block_stmts);
+}
+
+std::shared_ptr<Expr> ASTBuilder::call_expr(LoxParser::CallExprContext *ctx)
+{
+    std::shared_ptr<Expr> expr = std::make_shared<Variable>(ctx->IDENTIFIER()->getSymbol());
+    // The children after the callee are argument lists and member accesses,
+    // with the periods before the members as terminal nodes
+    for (size_t i = 1; i < ctx->children.size(); ++i) {
+        auto *child = ctx->children[i];
+        if (auto *args = dynamic_cast<LoxParser::ArgumentsContext *>(child)) {
+            expr = std::make_shared<Call>(expr, args->RIGHT_PAREN()->getSymbol(), arguments(args));
+        } else if (auto *member = dynamic_cast<LoxParser::MemberIdentifierContext *>(child)) {
+            expr = std::make_shared<Get>(expr, member->IDENTIFIER()->getSymbol());
+        }
+    }
     return expr;
 }
+
+std::vector<std::shared_ptr<Expr>> ASTBuilder::arguments(LoxParser::ArgumentsContext *ctx)
+{
+    std::vector<std::shared_ptr<Expr>> args;
+    for (auto &e : ctx->expr()) {
+        args.push_back(build_expr(e));
+    }
+    return args;
+}
+
+void ASTBuilder::binary(antlr4::ParserRuleContext *ctx, antlr4::Token *op)
+{
+    auto left = build_expr(ctx->children[0]);
+    auto right = build_expr(ctx->children[2]);
+    expr_result = std::make_shared<Binary>(left, op, right);
+}
@@ -11,7 +11,10 @@
 
 using namespace loxgrammar;
 
-// Construct the AST by visiting the input parse tree
+// Construct the AST by visiting the input parse tree. The visitor is only used to
+// dispatch on the type of declaration, statement or expression, the nodes are
+// passed back through the typed result members rather than boxed in the
+// antlrcpp::Any each visit method returns, which is always empty.
 struct ASTBuilder : public LoxParserBaseVisitor {
     std::vector<std::shared_ptr<Stmt>> statements;
 
@@ -19,14 +22,10 @@ struct ASTBuilder : public LoxParserBaseVisitor {
 
     antlrcpp::Any visitFunctionDecl(LoxParser::FunctionDeclContext *ctx) override;
 
-    antlrcpp::Any visitFunction(LoxParser::FunctionContext *ctx) override;
-
     antlrcpp::Any visitClassDecl(LoxParser::ClassDeclContext *ctx) override;
 
     antlrcpp::Any visitVarDeclStmt(LoxParser::VarDeclStmtContext *ctx) override;
 
-    antlrcpp::Any visitVarDecl(LoxParser::VarDeclContext *ctx) override;
-
     antlrcpp::Any visitIfStmt(LoxParser::IfStmtContext *ctx) override;
 
     antlrcpp::Any visitWhileStmt(LoxParser::WhileStmtContext *ctx) override;
@@ -43,9 +42,7 @@ struct ASTBuilder : public LoxParserBaseVisitor {
 
     antlrcpp::Any visitUnary(LoxParser::UnaryContext *ctx) override;
 
-    antlrcpp::Any visitCallExpr(LoxParser::CallExprContext *ctx) override;
-    antlrcpp::Any visitArguments(LoxParser::ArgumentsContext *ctx) override;
-    antlrcpp::Any visitMemberIdentifier(LoxParser::MemberIdentifierContext *ctx) override;
+    antlrcpp::Any visitCall(LoxParser::CallContext *ctx) override;
 
     antlrcpp::Any visitMult(LoxParser::MultContext *ctx) override;
     antlrcpp::Any visitDiv(LoxParser::DivContext *ctx) override;
@@ -61,4 +58,26 @@ struct ASTBuilder : public LoxParserBaseVisitor {
     antlrcpp::Any visitParens(LoxParser::ParensContext *ctx) override;
 
     antlrcpp::Any visitPrimary(LoxParser::PrimaryContext *ctx) override;
+
+private:
+    // The node built by the last visit
+    std::shared_ptr<Stmt> stmt_result;
+    std::shared_ptr<Expr> expr_result;
+
+    std::shared_ptr<Stmt> build_stmt(antlr4::tree::ParseTree *ctx);
+
+    std::shared_ptr<Expr> build_expr(antlr4::tree::ParseTree *ctx);
+
+    std::shared_ptr<Function> function(LoxParser::FunctionContext *ctx);
+
+    std::shared_ptr<Stmt> var_decl(LoxParser::VarDeclContext *ctx);
+
+    std::shared_ptr<Stmt> block(LoxParser::BlockContext *ctx);
+
+    std::shared_ptr<Expr> call_expr(LoxParser::CallExprContext *ctx);
+
+    std::vector<std::shared_ptr<Expr>> arguments(LoxParser::ArgumentsContext *ctx);
+
+    // Set the result to the binary expression of the context's two operands
+    void binary(antlr4::ParserRuleContext *ctx, antlr4::Token *op);
 };
@@ -0,0 +1,327 @@
+#include "ast_listener.h"
+#include <algorithm>
+#include "number.h"
+
+namespace {
+antlr4::Token *token(antlr4::tree::TerminalNode *node)
+{
+    return node ? node->getSymbol() : nullptr;
+}
+}
+
+void ASTListener::rewind(size_t n)
+{
+    statements.resize(std::min(n, statements.size()));
+    exprs.clear();
+    functions.clear();
+    params.clear();
+    fors.clear();
+    marks.clear();
+}
+
+void ASTListener::exitFunctionDecl(LoxParser::FunctionDeclContext *)
+{
+    std::shared_ptr<Function> fn;
+    if (!functions.empty()) {
+        fn = functions.back();
+        functions.pop_back();
+    }
+    statements.push_back(fn);
+}
+
+void ASTListener::enterFunction(LoxParser::FunctionContext *)
+{
+    params.emplace_back();
+}
+
+void ASTListener::exitFunction(LoxParser::FunctionContext *ctx)
+{
+    auto body = pop_stmt();
+    auto fn = std::make_shared<Function>(token(ctx->IDENTIFIER()), params.back(), body);
+    params.pop_back();
+    functions.push_back(fn);
+}
+
+void ASTListener::exitParameters(LoxParser::ParametersContext *ctx)
+{
+    for (auto *p : ctx->IDENTIFIER()) {
+        params.back().push_back(p->getSymbol());
+    }
+}
+
+void ASTListener::enterClassDecl(LoxParser::ClassDeclContext *)
+{
+    marks.push_back(functions.size());
+}
+
+void ASTListener::exitClassDecl(LoxParser::ClassDeclContext *ctx)
+{
+    const size_t mark = pop_mark(functions.size());
+    std::vector<std::shared_ptr<Function>> methods(functions.begin() + mark, functions.end());
+    functions.resize(mark);
+    statements.push_back(std::make_shared<Class>(token(ctx->IDENTIFIER()), methods));
+}
+
+void ASTListener::exitVarDecl(LoxParser::VarDeclContext *ctx)
+{
+    std::shared_ptr<Expr> initializer;
+    if (ctx->EQUAL()) {
+        initializer = pop_expr();
+    }
+    statements.push_back(std::make_shared<Var>(token(ctx->IDENTIFIER()), initializer));
+}
+
+void ASTListener::exitIfStmt(LoxParser::IfStmtContext *ctx)
+{
+    std::shared_ptr<Stmt> else_branch;
+    if (ctx->ELSE()) {
+        else_branch = pop_stmt();
+    }
+    auto then_branch = pop_stmt();
+    auto condition = pop_expr();
+    statements.push_back(std::make_shared<If>(condition, then_branch, else_branch));
+}
+
+void ASTListener::exitWhileStmt(LoxParser::WhileStmtContext *)
+{
+    auto body = pop_stmt();
+    auto condition = pop_expr();
+    statements.push_back(std::make_shared<While>(condition, body));
+}
+
+void ASTListener::enterForStmt(LoxParser::ForStmtContext *)
+{
+    fors.push_back(ForClauses{statements.size(), nullptr, nullptr});
+}
+
+void ASTListener::exitForStmt(LoxParser::ForStmtContext *)
+{
+    // Convert the for syntax sugar to a while statement in the AST, the same
+    // as the ASTBuilder
+    std::shared_ptr<Stmt> body = pop_stmt();
+    ForClauses clauses = fors.back();
+    fors.pop_back();
+
+    // Anything left above the loop's mark is the initializer
+    std::shared_ptr<Stmt> initializer;
+    if (statements.size() > clauses.statements) {
+        initializer = pop_stmt();
+    }
+
+    auto condition = clauses.condition;
+    if (!condition) {
+        condition = std::make_shared<Literal>(true);
+    }
+
+    if (clauses.advance) {
+        auto advance = std::make_shared<Expression>(clauses.advance);
+        body = std::make_shared<Block>(std::vector<std::shared_ptr<Stmt>>{body, advance});
+    }
+
+    body = std::make_shared<While>(condition, body);
+    if (initializer) {
+        body = std::make_shared<Block>(std::vector<std::shared_ptr<Stmt>>{initializer, body});
+    }
+    statements.push_back(body);
+}
+
+void ASTListener::exitForInit(LoxParser::ForInitContext *)
+{
+    statements.push_back(std::make_shared<Expression>(pop_expr()));
+}
+
+void ASTListener::exitForCond(LoxParser::ForCondContext *)
+{
+    fors.back().condition = pop_expr();
+}
+
+void ASTListener::exitForAdvance(LoxParser::ForAdvanceContext *)
+{
+    fors.back().advance = pop_expr();
+}
+
+void ASTListener::exitPrintStmt(LoxParser::PrintStmtContext *)
+{
+    statements.push_back(std::make_shared<Print>(pop_expr()));
+}
+
+void ASTListener::exitReturnStmt(LoxParser::ReturnStmtContext *ctx)
+{
+    statements.push_back(std::make_shared<Return>(token(ctx->RETURN()), pop_expr()));
+}
+
+void ASTListener::enterBlock(LoxParser::BlockContext *)
+{
+    marks.push_back(statements.size());
+}
+
+void ASTListener::exitBlock(LoxParser::BlockContext *)
+{
+    const size_t mark = pop_mark(statements.size());
+    std::vector<std::shared_ptr<Stmt>> block_stmts(statements.begin() + mark, statements.end());
+    statements.resize(mark);
+    statements.push_back(std::make_shared<Block>(block_stmts));
+}
+
+void ASTListener::exitExprStmt(LoxParser::ExprStmtContext *)
+{
+    statements.push_back(std::make_shared<Expression>(pop_expr()));
+}
+
+void ASTListener::exitUnary(LoxParser::UnaryContext *ctx)
+{
+    auto *op = ctx->MINUS() ? ctx->MINUS()->getSymbol() : token(ctx->BANG());
+    exprs.push_back(std::make_shared<Unary>(op, pop_expr()));
+}
+
+void ASTListener::enterCallExpr(LoxParser::CallExprContext *ctx)
+{
+    // The callee has to be on the stack before any of the calls or member
+    // accesses on it exit
+    exprs.push_back(std::make_shared<Variable>(ctx->getStart()));
+}
+
+void ASTListener::enterArguments(LoxParser::ArgumentsContext *)
+{
+    marks.push_back(exprs.size());
+}
+
+void ASTListener::exitArguments(LoxParser::ArgumentsContext *ctx)
+{
+    const size_t mark = pop_mark(exprs.size());
+    std::vector<std::shared_ptr<Expr>> args(exprs.begin() + mark, exprs.end());
+    exprs.resize(mark);
+    auto callee = pop_expr();
+    exprs.push_back(std::make_shared<Call>(callee, token(ctx->RIGHT_PAREN()), args));
+}
+
+void ASTListener::exitMemberIdentifier(LoxParser::MemberIdentifierContext *ctx)
+{
+    auto object = pop_expr();
+    exprs.push_back(std::make_shared<Get>(object, token(ctx->IDENTIFIER())));
+}
+
+void ASTListener::exitMult(LoxParser::MultContext *ctx)
+{
+    binary(ctx);
+}
+
+void ASTListener::exitDiv(LoxParser::DivContext *ctx)
+{
+    binary(ctx);
+}
+
+void ASTListener::exitAddSub(LoxParser::AddSubContext *ctx)
+{
+    binary(ctx);
+}
+
+void ASTListener::exitComparison(LoxParser::ComparisonContext *ctx)
+{
+    binary(ctx);
+}
+
+void ASTListener::exitEquality(LoxParser::EqualityContext *ctx)
+{
+    binary(ctx);
+}
+
+void ASTListener::exitLogicAnd(LoxParser::LogicAndContext *ctx)
+{
+    binary(ctx);
+}
+
+void ASTListener::exitLogicOr(LoxParser::LogicOrContext *ctx)
+{
+    binary(ctx);
+}
+
+void ASTListener::exitAssign(LoxParser::AssignContext *ctx)
+{
+    auto rhs = pop_expr();
+    // Without a parse tree the callExpr child isn't attached to the context,
+    // but the period after it is, if it's there we're setting a struct member
+    if (ctx->PERIOD()) {
+        auto obj = pop_expr();
+        exprs.push_back(std::make_shared<Set>(obj, token(ctx->IDENTIFIER()), rhs));
+    } else {
+        exprs.push_back(std::make_shared<Assign>(token(ctx->IDENTIFIER()), rhs));
+    }
+}
+
+void ASTListener::exitParens(LoxParser::ParensContext *)
+{
+    exprs.push_back(std::make_shared<Grouping>(pop_expr()));
+}
+
+void ASTListener::exitPrimary(LoxParser::PrimaryContext *ctx)
+{
+    auto *t = ctx->getStart();
+    std::shared_ptr<Expr> expr;
+    switch (t->getType()) {
+    case LoxParser::IDENTIFIER:
+        expr = std::make_shared<Variable>(t);
+        break;
+    case LoxParser::NUMBER:
+        expr = std::make_shared<Literal>(parse_number(t->getText()));
+        break;
+    case LoxParser::STRING: {
+        // Remove the opening and closing quotes
+        auto str = t->getText();
+        expr = std::make_shared<Literal>(str.substr(1, str.size() - 2));
+        break;
+    }
+    case LoxParser::TRUE:
+        expr = std::make_shared<Literal>(true);
+        break;
+    case LoxParser::FALSE:
+        expr = std::make_shared<Literal>(false);
+        break;
+    case LoxParser::NIL:
+        expr = std::make_shared<Literal>(std::any());
+        break;
+    default:
+        break;
+    }
+    exprs.push_back(expr);
+}
+
+std::shared_ptr<Expr> ASTListener::pop_expr()
+{
+    if (exprs.empty()) {
+        return nullptr;
+    }
+    auto expr = exprs.back();
+    exprs.pop_back();
+    return expr;
+}
+
+std::shared_ptr<Stmt> ASTListener::pop_stmt()
+{
+    if (statements.empty()) {
+        return nullptr;
+    }
+    auto stmt = statements.back();
+    statements.pop_back();
+    return stmt;
+}
+
+size_t ASTListener::pop_mark(size_t stack_size)
+{
+    const size_t mark = marks.back();
+    marks.pop_back();
+    return std::min(mark, stack_size);
+}
+
+void ASTListener::binary(antlr4::ParserRuleContext *ctx)
+{
+    antlr4::Token *op = nullptr;
+    if (!ctx->children.empty()) {
+        if (auto *node = dynamic_cast<antlr4::tree::TerminalNode *>(ctx->children[0])) {
+            op = node->getSymbol();
+        }
+    }
+    auto right = pop_expr();
+    auto left = pop_expr();
+    exprs.push_back(std::make_shared<Binary>(left, op, right));
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "LoxParserBaseListener.h"
+#include "antlr4-common.h"
+#include "expr.h"
+
+using namespace loxgrammar;
+
+// Construct the AST from the parser's rule events, so the parser doesn't need to
+// build a parse tree. When a rule exits its children's nodes have already been
+// built, so they're popped off the stacks and replaced by the rule's node. At the
+// end of the parse the statement stack holds the top level declarations.
+//
+// A rule that failed to parse still exits, so the stacks are only consistent
+// while the parse succeeds. Popping an empty stack gives a null node instead of
+// failing, and the caller discards the nodes built by a failed declaration
+struct ASTListener : public LoxParserBaseListener {
+    std::vector<std::shared_ptr<Stmt>> statements;
+
+    // Drop everything built since there were n statements, the other stacks
+    // are empty between top level declarations
+    void rewind(size_t n);
+
+    void exitFunctionDecl(LoxParser::FunctionDeclContext *ctx) override;
+
+    void enterFunction(LoxParser::FunctionContext *ctx) override;
+    void exitFunction(LoxParser::FunctionContext *ctx) override;
+    void exitParameters(LoxParser::ParametersContext *ctx) override;
+
+    void enterClassDecl(LoxParser::ClassDeclContext *ctx) override;
+    void exitClassDecl(LoxParser::ClassDeclContext *ctx) override;
+
+    void exitVarDecl(LoxParser::VarDeclContext *ctx) override;
+
+    void exitIfStmt(LoxParser::IfStmtContext *ctx) override;
+
+    void exitWhileStmt(LoxParser::WhileStmtContext *ctx) override;
+
+    void enterForStmt(LoxParser::ForStmtContext *ctx) override;
+    void exitForStmt(LoxParser::ForStmtContext *ctx) override;
+    void exitForInit(LoxParser::ForInitContext *ctx) override;
+    void exitForCond(LoxParser::ForCondContext *ctx) override;
+    void exitForAdvance(LoxParser::ForAdvanceContext *ctx) override;
+
+    void exitPrintStmt(LoxParser::PrintStmtContext *ctx) override;
+
+    void exitReturnStmt(LoxParser::ReturnStmtContext *ctx) override;
+
+    void enterBlock(LoxParser::BlockContext *ctx) override;
+    void exitBlock(LoxParser::BlockContext *ctx) override;
+
+    void exitExprStmt(LoxParser::ExprStmtContext *ctx) override;
+
+    void exitUnary(LoxParser::UnaryContext *ctx) override;
+
+    void enterCallExpr(LoxParser::CallExprContext *ctx) override;
+    void enterArguments(LoxParser::ArgumentsContext *ctx) override;
+    void exitArguments(LoxParser::ArgumentsContext *ctx) override;
+    void exitMemberIdentifier(LoxParser::MemberIdentifierContext *ctx) override;
+
+    void exitMult(LoxParser::MultContext *ctx) override;
+    void exitDiv(LoxParser::DivContext *ctx) override;
+    void exitAddSub(LoxParser::AddSubContext *ctx) override;
+    void exitComparison(LoxParser::ComparisonContext *ctx) override;
+    void exitEquality(LoxParser::EqualityContext *ctx) override;
+
+    void exitLogicAnd(LoxParser::LogicAndContext *ctx) override;
+    void exitLogicOr(LoxParser::LogicOrContext *ctx) override;
+
+    void exitAssign(LoxParser::AssignContext *ctx) override;
+
+    void exitParens(LoxParser::ParensContext *ctx) override;
+
+    void exitPrimary(LoxParser::PrimaryContext *ctx) override;
+
+private:
+    // The parts of a for loop aren't statements or expressions of the loop
+    // itself, so they're collected here until the loop exits
+    struct ForClauses {
+        size_t statements;
+        std::shared_ptr<Expr> condition;
+        std::shared_ptr<Expr> advance;
+    };
+
+    std::vector<std::shared_ptr<Expr>> exprs;
+    std::vector<std::shared_ptr<Function>> functions;
+    std::vector<std::vector<antlr4::Token *>> params;
+    std::vector<ForClauses> fors;
+    // The size of the stack being collected into a block, argument list or
+    // class when it was entered
+    std::vector<size_t> marks;
+
+    std::shared_ptr<Expr> pop_expr();
+
+    std::shared_ptr<Stmt> pop_stmt();
+
+    size_t pop_mark(size_t stack_size);
+
+    // Replace the two operands on the stack with a binary expression, the
+    // operator is the only token matched directly by the context
+    void binary(antlr4::ParserRuleContext *ctx);
+};
@@ -0,0 +1,233 @@
+#include "frontend.h"
+#include <cstdlib>
+#include <iostream>
+#include "ast_builder.h"
+#include "scanner_token_source.h"
+#include "util.h"
+
+namespace {
+// Covers every declaration, statement and expression form, so warming up on it
+// visits each of the parser's decisions
+const char *const warm_up_corpus = R"(
+var a = 1;
+var b;
+var s = "warm" ;
+fun add(x, y) {
+    return x + y;
+}
+fun fib(n) {
+    if (n < 2) {
+        return n;
+    } else {
+        return fib(n - 1) + fib(n - 2);
+    }
+}
+class Point {
+    init(x, y) {
+        this.x = x;
+        this.y = y;
+    }
+    sum() {
+        return this.x + this.y;
+    }
+}
+var p = Point(1, 2);
+p.x = p.y * 2 / 4 - -1;
+b = !(a == 1) or a != 2 and a <= 3;
+print p.sum() >= 1 and s == nil;
+print add(a, fib(2)) > 0 == true;
+for (var i = 0; i < 2; i = i + 1) {
+    print i;
+}
+for (a = 0; a < 1;) {
+    a = a + 1;
+}
+for (;;) {
+    return false;
+}
+while (a > 0) a = a - 1;
+{
+    var c = add(1, 2);
+    print c;
+}
+// A comment
+print a;
+)";
+}
+
+Frontend::Frontend(const RunOptions &options)
+    : options(options), lexer(&empty_input), parser(nullptr)
+{
+}
+
+bool Frontend::parse(const std::string &source,
+                     std::vector<std::shared_ptr<Stmt>> &statements,
+                     std::ostream *trace)
+{
+    antlr4::CommonTokenStream *tokens = lex(source, trace);
+    return tokens && parse(*tokens, statements, trace);
+}
+
+antlr4::CommonTokenStream *Frontend::lex(const std::string &source, std::ostream *trace)
+{
+    antlr4::TokenSource *token_source = &lexer;
+    errors.had_error = false;
+    if (options.antlr_lexer) {
+        inputs.push_back(std::make_unique<antlr4::ANTLRInputStream>(source));
+        lexer.setInputStream(inputs.back().get());
+    } else {
+        scanner = std::make_unique<ScannerTokenSource>(source, errors);
+        token_source = scanner.get();
+    }
+
+    token_streams.push_back(std::make_unique<antlr4::CommonTokenStream>(token_source));
+    antlr4::CommonTokenStream &tokens = *token_streams.back();
+    tokens.fill();
+    if (errors.had_error) {
+        return nullptr;
+    }
+
+    if (trace) {
+        for (const auto &t : tokens.getTokens()) {
+            *trace << t->toString() << "\n";
+        }
+    }
+    return &tokens;
+}
+
+bool Frontend::parse(antlr4::CommonTokenStream &tokens,
+                     std::vector<std::shared_ptr<Stmt>> &statements,
+                     std::ostream *trace)
+{
+    parser.setTokenStream(&tokens);
+    const size_t n_errors = parser.getNumberOfSyntaxErrors();
+    if (options.parse_events) {
+        ASTListener builder;
+        const bool ok = build_ast(tokens, builder, trace);
+        statements = std::move(builder.statements);
+        return ok;
+    }
+
+    antlr4::tree::ParseTree *tree = parse_file(tokens, trace);
+    if (trace) {
+        *trace << tree->toStringTree(&parser) << "\n";
+    }
+
+    ASTBuilder ast_builder;
+    ast_builder.visit(tree);
+    statements = std::move(ast_builder.statements);
+    return parser.getNumberOfSyntaxErrors() == n_errors;
+}
+
+LoxParser::FileContext *Frontend::parse_file(antlr4::CommonTokenStream &tokens,
+                                             std::ostream *trace)
+{
+    // Try the faster SLL prediction first, bailing out on the first error.
+    // SLL can fail on input full LL accepts, and a genuine syntax error should
+    // be reported by the default strategy, so either way we re-parse with LL
+    parser.setBuildParseTree(true);
+    use_sll();
+    try {
+        LoxParser::FileContext *tree = parser.file();
+        if (trace) {
+            *trace << "Parse mode: SLL\n";
+        }
+        return tree;
+    } catch (const antlr4::ParseCancellationException &) {
+    }
+
+    tokens.reset();
+    parser.reset();
+    use_ll();
+    LoxParser::FileContext *tree = parser.file();
+    if (trace) {
+        *trace << "Parse mode: LL\n";
+    }
+    return tree;
+}
+
+bool Frontend::build_ast(antlr4::CommonTokenStream &tokens,
+                         ASTListener &builder,
+                         std::ostream *trace)
+{
+    // Parse a top level declaration at a time, building its AST from the parse
+    // events and then freeing its contexts, so the parse tree of the whole file
+    // never exists. Each declaration gets the same SLL then LL fallback as
+    // parse_file, and the nodes built by a failed attempt are dropped
+    parser.setBuildParseTree(false);
+    parser.addParseListener(&builder);
+
+    const size_t initial_errors = parser.getNumberOfSyntaxErrors();
+    size_t declarations = 0;
+    size_t ll_declarations = 0;
+    while (tokens.LA(1) != antlr4::Token::EOF) {
+        const size_t start = tokens.index();
+        const size_t n_statements = builder.statements.size();
+        const size_t n_errors = parser.getNumberOfSyntaxErrors();
+
+        use_sll();
+        try {
+            parser.declaration();
+        } catch (const antlr4::ParseCancellationException &) {
+            parser.release_contexts();
+            builder.rewind(n_statements);
+            tokens.seek(start);
+            use_ll();
+            parser.declaration();
+            ++ll_declarations;
+        }
+        parser.release_contexts();
+        ++declarations;
+
+        if (parser.getNumberOfSyntaxErrors() != n_errors) {
+            // Keep parsing to report any other errors, but the nodes are junk
+            builder.rewind(n_statements);
+            if (tokens.index() == start) {
+                tokens.consume();
+            }
+        }
+    }
+    parser.removeParseListener(&builder);
+
+    if (trace) {
+        if (ll_declarations == 0) {
+            *trace << "Parse mode: SLL\n";
+        } else {
+            *trace << "Parse mode: LL for " << ll_declarations << " of " << declarations
+                   << " declarations\n";
+        }
+    }
+    return parser.getNumberOfSyntaxErrors() == initial_errors;
+}
+
+void Frontend::use_sll()
+{
+    parser.getInterpreter<antlr4::atn::ParserATNSimulator>()->setPredictionMode(
+        antlr4::atn::PredictionMode::SLL);
+    parser.removeErrorListeners();
+    parser.setErrorHandler(std::make_shared<antlr4::BailErrorStrategy>());
+}
+
+void Frontend::use_ll()
+{
+    parser.getInterpreter<antlr4::atn::ParserATNSimulator>()->setPredictionMode(
+        antlr4::atn::PredictionMode::LL);
+    parser.addErrorListener(&antlr4::ConsoleErrorListener::INSTANCE);
+    parser.setErrorHandler(std::make_shared<antlr4::DefaultErrorStrategy>());
+}
+
+void warm_up(const RunOptions &options)
+{
+    std::string corpus = warm_up_corpus;
+    if (const char *file = std::getenv("LOX_WARMUP_CORPUS")) {
+        try {
+            corpus = get_file_content(file);
+        } catch (const std::runtime_error &e) {
+            std::cerr << "warm up: " << e.what() << ", using the built in corpus\n";
+        }
+    }
+
+    Frontend frontend(options);
+    std::vector<std::shared_ptr<Stmt>> statements;
+    frontend.parse(corpus, statements);
+}
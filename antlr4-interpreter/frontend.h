@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "LoxLexer.h"
+#include "LoxParser.h"
+#include "antlr4-runtime.h"
+#include "ast_listener.h"
+#include "error_reporter.h"
+#include "expr.h"
+
+using namespace loxgrammar;
+
+struct RunOptions {
+    // Build the AST from parse events with ASTListener, one declaration at a
+    // time, instead of by visiting a full parse tree
+    bool parse_events = false;
+    // Lex with the generated LoxLexer instead of the hand-written scanner
+    bool antlr_lexer = false;
+};
+
+// The parser keeps every context it creates until it's reset, this lets the
+// contexts be freed after each declaration without seeking back to the start
+struct EventParser : LoxParser {
+    using LoxParser::LoxParser;
+
+    void release_contexts()
+    {
+        _tracker.reset();
+    }
+};
+
+// Lexes and parses scripts to statements. The lexer and parser are created once
+// and given each script or REPL line with setInputStream/setTokenStream. The
+// token streams (and the inputs the LoxLexer's tokens read their text from)
+// are kept, since the AST points to the tokens.
+class Frontend {
+    RunOptions options;
+    ErrorReporter errors;
+    // What the lexer reads until it's given the first source, setInputStream
+    // seeks the current input so it can't be null
+    antlr4::ANTLRInputStream empty_input;
+    LoxLexer lexer;
+    // The scanner of the last source lexed, the parser can ask the token source
+    // for a factory to create missing tokens
+    std::unique_ptr<antlr4::TokenSource> scanner;
+    EventParser parser;
+    std::vector<std::unique_ptr<antlr4::ANTLRInputStream>> inputs;
+    std::vector<std::unique_ptr<antlr4::CommonTokenStream>> token_streams;
+
+public:
+    Frontend(const RunOptions &options);
+
+    // Parse the source, returning false if there were errors. The tokens, the
+    // parse tree and the parse mode are written to the trace stream if given
+    bool parse(const std::string &source,
+               std::vector<std::shared_ptr<Stmt>> &statements,
+               std::ostream *trace = nullptr);
+
+    // The two phases of parse, lex returns nullptr if there were errors
+    antlr4::CommonTokenStream *lex(const std::string &source, std::ostream *trace = nullptr);
+
+    bool parse(antlr4::CommonTokenStream &tokens,
+               std::vector<std::shared_ptr<Stmt>> &statements,
+               std::ostream *trace = nullptr);
+
+private:
+    LoxParser::FileContext *parse_file(antlr4::CommonTokenStream &tokens, std::ostream *trace);
+
+    bool build_ast(antlr4::CommonTokenStream &tokens, ASTListener &builder, std::ostream *trace);
+
+    // Predict with SLL and give up on the first syntax error
+    void use_sll();
+
+    // Predict with full LL, reporting and recovering from syntax errors
+    void use_ll();
+};
+
+// Parse a representative program so the lexer and parser DFA caches, which are
+// shared by every instance, are built before the first script. The program is
+// read from the file named by LOX_WARMUP_CORPUS if it's set, otherwise a built
+// in one is used. The runtime has no way to save the caches, so this has to be
+// done in each process.
+void warm_up(const RunOptions &options);
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bench_report.h"
+#include "frontend.h"
+#include "interpreter.h"
+#include "node_counter.h"
+#include "resolver.h"
+#include "util.h"
+
+// Runs a script through the lexer, parser and resolver without evaluating it,
+// reporting the time and peak memory of each phase. See bench/compare.py
+int main(int argc, char **argv)
+{
+    std::string script;
+    RunOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--parse-events") {
+            options.parse_events = true;
+        } else if (arg == "--antlr-lexer") {
+            options.antlr_lexer = true;
+        } else if (script.empty() && arg.rfind("--", 0) != 0) {
+            script = arg;
+        } else {
+            script.clear();
+            break;
+        }
+    }
+    if (script.empty()) {
+        std::cerr << "Usage: frontend_bench [--parse-events] [--antlr-lexer] script\n";
+        return 1;
+    }
+
+    std::string name = "antlr";
+    if (options.antlr_lexer) {
+        name += "-lexer";
+    }
+    if (options.parse_events) {
+        name += "-events";
+    }
+
+    try {
+        BenchReport report(name);
+        const std::string source = report.time("read", [&] { return get_file_content(script); });
+
+        Frontend frontend(options);
+        antlr4::CommonTokenStream *tokens =
+            report.time("lex", [&] { return frontend.lex(source); });
+        if (!tokens) {
+            return 1;
+        }
+
+        std::vector<std::shared_ptr<Stmt>> statements;
+        const bool parsed =
+            report.time("parse", [&] { return frontend.parse(*tokens, statements); });
+
+        Interpreter interpreter;
+        report.time("resolve", [&] {
+            Resolver resolver(interpreter);
+            resolver.resolve(statements);
+        });
+
+        NodeCounter counter;
+        report.print(
+            std::cout, script, source.size(), tokens->size(), counter.count(statements));
+        return parsed ? 0 : 1;
+    } catch (const std::runtime_error &e) {
+        std::cerr << "frontend_bench: " << e.what() << "\n";
+        return 1;
+    }
+}
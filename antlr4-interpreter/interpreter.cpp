@@ -3,6 +3,8 @@
 #include "LoxParser.h"
 #include "lox_callable.h"
 #include "lox_class.h"
+#include "number.h"
+#include "rope.h"
 #include "util.h"
 
 using namespace loxgrammar;
@@ -37,6 +39,7 @@ const std::any &Interpreter::evaluate(const Expr &expr)
 Interpreter::Interpreter()
     : float_id(std::type_index(typeid(float))),
       string_id(std::type_index(typeid(std::string))),
+      rope_id(std::type_index(typeid(std::shared_ptr<Rope>))),
       bool_id(std::type_index(typeid(bool))),
       nil_id(std::type_index(typeid(void))),
       callable_id(std::type_index(typeid(std::shared_ptr<LoxCallable>)))
@@ -50,6 +53,8 @@ Interpreter::Interpreter()
     globals->define("clock", std::shared_ptr<LoxCallable>(std::make_shared<Clock>()));
     globals->define("_ci_test_add",
                     std::shared_ptr<LoxCallable>(std::make_shared<CITestAdd>()));
+    globals->define("StringBuilder",
+                    std::shared_ptr<LoxCallable>(std::make_shared<StringBuilder>()));
 }
 
 void Interpreter::visit(const Grouping &g)
@@ -89,17 +94,14 @@ void Interpreter::visit(const Binary &b)
         check_type(left, {float_id, string_id}, b.op);
         if (left.type() == typeid(float) && right.type() == typeid(float)) {
             result = std::any_cast<float>(left) + std::any_cast<float>(right);
-        } else if (left.type() == typeid(std::string) && right.type() == typeid(std::string)) {
-            result = std::any_cast<std::string>(left) + std::any_cast<std::string>(right);
         } else {
-            // We know one is a string and one is a float
+            // At least one is a string, and strings are concatenated lazily as ropes
             if (left.type() == typeid(float)) {
-                result = std::to_string(std::any_cast<float>(left)) +
-                         std::any_cast<std::string>(right);
-            } else {
-                result = std::any_cast<std::string>(left) +
-                         std::to_string(std::any_cast<float>(right));
+                left = format_number(std::any_cast<float>(left));
+            } else if (right.type() == typeid(float)) {
+                right = format_number(std::any_cast<float>(right));
             }
+            result = concatenate(left, right);
         }
         break;
     case LoxParser::MINUS:
@@ -274,9 +276,9 @@ void Interpreter::visit(const Print &p)
     std::any val = evaluate(*p.expr);
     if (val.has_value()) {
         if (val.type() == typeid(float)) {
-            std::cout << std::any_cast<float>(val) << "\n";
-        } else if (val.type() == typeid(std::string)) {
-            std::cout << std::any_cast<std::string>(val) << "\n";
+            std::cout << format_number(std::any_cast<float>(val)) << "\n";
+        } else if (is_string(val)) {
+            std::cout << as_string(val) << "\n";
         } else if (val.type() == typeid(bool)) {
             std::cout << (std::any_cast<bool>(val) ? "true" : "false") << "\n";
         } else if (val.type() == typeid(std::shared_ptr<LoxCallable>)) {
@@ -357,8 +359,9 @@ void Interpreter::check_type(const std::any &val,
                              const std::vector<std::type_index> &valid_types,
                              const antlr4::Token *token)
 {
+    const auto ty = type_of(val);
     for (const auto &t : valid_types) {
-        if (std::type_index(val.type()) == t) {
+        if (ty == t) {
             return;
         }
     }
@@ -377,12 +380,21 @@ void Interpreter::check_same_type(const std::any &a,
                                   const std::any &b,
                                   const antlr4::Token *token) const
 {
-    if (a.type() != b.type()) {
+    if (type_of(a) != type_of(b)) {
         throw InterpreterError(
             token, "Expected " + pretty_type_name(a) + " but got " + pretty_type_name(b));
     }
 }
 
+std::type_index Interpreter::type_of(const std::any &val) const
+{
+    const auto ty = std::type_index(val.type());
+    if (ty == rope_id) {
+        return string_id;
+    }
+    return ty;
+}
+
 bool Interpreter::is_true(const std::any &x) const
 {
     const auto ty = std::type_index(x.type());
@@ -402,11 +414,11 @@ bool Interpreter::is_true(const std::any &x) const
 bool Interpreter::is_equal(const std::any &a, const std::any &b) const
 {
     // Comparing objects of different types is always false
-    if (a.type() != b.type()) {
+    const auto a_ty = type_of(a);
+    if (a_ty != type_of(b)) {
         return false;
     }
 
-    const auto a_ty = std::type_index(a.type());
     if (a_ty == nil_id) {
         return true;
     }
@@ -414,7 +426,7 @@ bool Interpreter::is_equal(const std::any &a, const std::any &b) const
         return std::any_cast<float>(a) == std::any_cast<float>(b);
     }
     if (a_ty == string_id) {
-        return std::any_cast<std::string>(a) == std::any_cast<std::string>(b);
+        return as_string(a) == as_string(b);
     }
     return std::any_cast<bool>(a) == std::any_cast<bool>(b);
 }
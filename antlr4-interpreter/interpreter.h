@@ -71,7 +71,7 @@ struct Interpreter : Expr::Visitor, Stmt::Visitor {
     void visit(const Class &c) override;
 
 private:
-    std::type_index float_id, string_id, bool_id, nil_id, callable_id;
+    std::type_index float_id, string_id, rope_id, bool_id, nil_id, callable_id;
     std::unordered_map<std::type_index, std::string> type_names;
 
     // Check if the type is one of the specified valid types, if not throws an
@@ -83,6 +83,9 @@ private:
     // Check if the two anys have the same type, if not throws an InterpreterError
     void check_same_type(const std::any &a, const std::any &b, const antlr4::Token *t) const;
 
+    // Get the type of the value, with ropes treated as strings
+    std::type_index type_of(const std::any &val) const;
+
     bool is_true(const std::any &x) const;
 
     bool is_equal(const std::any &a, const std::any &b) const;
@@ -1,6 +1,7 @@
 #include "lox_callable.h"
 #include <chrono>
 #include <iostream>
+#include "rope.h"
 
 size_t Clock::arity() const
 {
@@ -32,8 +33,8 @@ std::any CITestAdd::call(Interpreter &, std::vector<std::any> &args)
     std::any result;
     if (left.type() == typeid(float) && right.type() == typeid(float)) {
         result = std::any_cast<float>(left) + std::any_cast<float>(right);
-    } else if (left.type() == typeid(std::string) && right.type() == typeid(std::string)) {
-        result = std::any_cast<std::string>(left) + std::any_cast<std::string>(right);
+    } else if (is_string(left) && is_string(right)) {
+        result = as_string(left) + as_string(right);
     } else {
         throw InterpreterError(
             nullptr, "Invalid arguments to _ci_test_add: Must be two numbers of strings");
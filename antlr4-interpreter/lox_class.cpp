@@ -1,4 +1,7 @@
 #include "lox_class.h"
+#include "number.h"
+#include "rope.h"
+#include "util.h"
 
 LoxClass::LoxClass(const std::string &name) : name(name) {}
 
@@ -37,3 +40,66 @@ void LoxInstance::set(const antlr4::Token *name, const std::any &value)
 {
     fields[name->getText()] = value;
 }
+
+StringBuilder::StringBuilder() : LoxClass("StringBuilder") {}
+
+std::any StringBuilder::call(Interpreter &, std::vector<std::any> &)
+{
+    auto instance = std::make_shared<LoxInstance>(*this);
+    auto buffer = std::make_shared<std::string>();
+    instance->fields["append"] =
+        std::shared_ptr<LoxCallable>(std::make_shared<StringBuilderAppend>(buffer));
+    instance->fields["to_string"] =
+        std::shared_ptr<LoxCallable>(std::make_shared<StringBuilderToString>(buffer));
+    return instance;
+}
+
+StringBuilderAppend::StringBuilderAppend(const std::shared_ptr<std::string> &buffer)
+    : buffer(buffer)
+{
+}
+
+size_t StringBuilderAppend::arity() const
+{
+    return 1;
+}
+
+std::any StringBuilderAppend::call(Interpreter &, std::vector<std::any> &args)
+{
+    if (is_string(args[0])) {
+        *buffer += as_string(args[0]);
+    } else if (args[0].type() == typeid(float)) {
+        *buffer += format_number(std::any_cast<float>(args[0]));
+    } else {
+        throw InterpreterError(nullptr,
+                               "Invalid argument to StringBuilder.append: Must be a string "
+                               "or number but got " +
+                                   pretty_type_name(args[0].type()));
+    }
+    return std::any();
+}
+
+std::string StringBuilderAppend::to_string() const
+{
+    return "<fn append>";
+}
+
+StringBuilderToString::StringBuilderToString(const std::shared_ptr<std::string> &buffer)
+    : buffer(buffer)
+{
+}
+
+size_t StringBuilderToString::arity() const
+{
+    return 0;
+}
+
+std::any StringBuilderToString::call(Interpreter &, std::vector<std::any> &)
+{
+    return *buffer;
+}
+
+std::string StringBuilderToString::to_string() const
+{
+    return "<fn to_string>";
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include "antlr4-runtime.h"
@@ -29,3 +30,38 @@ struct LoxInstance {
 
     void set(const antlr4::Token *name, const std::any &value);
 };
+
+// Native class for building strings by appending pieces to a single buffer, instead
+// of creating a new string on each concatenation. Instances have two methods:
+// append(value), taking a string or number, and to_string().
+struct StringBuilder : LoxClass {
+    StringBuilder();
+
+    std::any call(Interpreter &interpreter, std::vector<std::any> &args) override;
+};
+
+// The append method of a StringBuilder instance
+struct StringBuilderAppend : LoxCallable {
+    std::shared_ptr<std::string> buffer;
+
+    StringBuilderAppend(const std::shared_ptr<std::string> &buffer);
+
+    size_t arity() const override;
+
+    std::any call(Interpreter &interpreter, std::vector<std::any> &args) override;
+
+    std::string to_string() const override;
+};
+
+// The to_string method of a StringBuilder instance
+struct StringBuilderToString : LoxCallable {
+    std::shared_ptr<std::string> buffer;
+
+    StringBuilderToString(const std::shared_ptr<std::string> &buffer);
+
+    size_t arity() const override;
+
+    std::any call(Interpreter &interpreter, std::vector<std::any> &args) override;
+
+    std::string to_string() const override;
+};
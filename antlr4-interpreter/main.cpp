@@ -1,45 +1,57 @@
-#include <fstream>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
-#include "LoxLexer.h"
-#include "LoxParser.h"
-#include "antlr4-runtime.h"
-#include "ast_builder.h"
 #include "ast_printer.h"
+#include "frontend.h"
 #include "interpreter.h"
 #include "resolver.h"
 #include "util.h"
 
-using namespace loxgrammar;
-
-void run_file(const std::string &file);
-void run_prompt();
-void run(antlr4::ANTLRInputStream &input, Interpreter &interpreter);
+void run_file(const std::string &file, const RunOptions &options);
+void run_prompt(const RunOptions &options);
+void run(const std::string &source, Frontend &frontend, Interpreter &interpreter);
 
 int main(int argc, char **argv)
 {
-    if (argc > 2) {
-        std::cerr << "Usage: interpreter [script]\n";
-        return 1;
+    std::string script;
+    RunOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--parse-events") {
+            options.parse_events = true;
+        } else if (arg == "--antlr-lexer") {
+            options.antlr_lexer = true;
+        } else if (script.empty() && arg.rfind("--", 0) != 0) {
+            script = arg;
+        } else {
+            std::cerr << "Usage: interpreter [--parse-events] [--antlr-lexer] [script]\n";
+            return 1;
+        }
     }
 
-    if (argc == 2) {
-        run_file(argv[1]);
+    if (!script.empty()) {
+        run_file(script, options);
     } else {
-        run_prompt();
+        run_prompt(options);
     }
 
     return 0;
 }
 
-void run_file(const std::string &file)
+void run_file(const std::string &file, const RunOptions &options)
 {
-    antlr4::ANTLRFileStream input;
-    input.loadFromFile(file);
     try {
+        const std::string source = get_file_content(file);
+        // A script only parses once, so warming up is only worth it to
+        // separate out the DFA construction when given a corpus
+        if (std::getenv("LOX_WARMUP_CORPUS")) {
+            warm_up(options);
+        }
+        Frontend frontend(options);
         Interpreter interpreter;
-        run(input, interpreter);
+        run(source, frontend, interpreter);
     } catch (const InterpreterError &e) {
         if (e.token) {
             // This seems to still crash with the file input stream?
@@ -55,15 +67,16 @@ void run_file(const std::string &file)
     }
 }
 
-void run_prompt()
+void run_prompt(const RunOptions &options)
 {
+    warm_up(options);
     std::cout << "> ";
     std::string line;
+    Frontend frontend(options);
     Interpreter interpreter;
     while (std::getline(std::cin, line)) {
-        antlr4::ANTLRInputStream input(line);
         try {
-            run(input, interpreter);
+            run(line, frontend, interpreter);
         } catch (const InterpreterError &e) {
             // Prompt doesn't quit on errors, just prints them (in run)
         }
@@ -71,31 +84,18 @@ void run_prompt()
     }
 }
 
-void run(antlr4::ANTLRInputStream &input, Interpreter &interpreter)
+void run(const std::string &source, Frontend &frontend, Interpreter &interpreter)
 {
-    LoxLexer lexer(&input);
-    antlr4::CommonTokenStream tokens(&lexer);
-    tokens.fill();
-
-    for (const auto &t : tokens.getTokens()) {
-        std::cerr << t->toString() << "\n";
+    std::vector<std::shared_ptr<Stmt>> statements;
+    if (!frontend.parse(source, statements, &std::cerr)) {
+        return;
     }
 
-    // TODO: handle errors in parser
-
-    LoxParser parser(&tokens);
-    antlr4::tree::ParseTree *tree = parser.file();
-
-    std::cerr << tree->toStringTree(&parser) << "\n";
-
-    ASTBuilder ast_builder;
-    ast_builder.visit(tree);
-
     Resolver resolver(interpreter);
-    resolver.resolve(ast_builder.statements);
+    resolver.resolve(statements);
 
     ProgramPrinter printer;
-    std::cerr << "Program:\n" << printer.print(ast_builder.statements) << "------\n";
+    std::cerr << "Program:\n" << printer.print(statements) << "------\n";
 
-    interpreter.evaluate(ast_builder.statements);
+    interpreter.evaluate(statements);
 }
@@ -0,0 +1,91 @@
+#include "rope.h"
+#include <vector>
+
+Rope::Rope(const std::string &str) : str(str), length(str.size()) {}
+
+Rope::Rope(const std::shared_ptr<Rope> &left, const std::shared_ptr<Rope> &right)
+    : left(left), right(right), length(left->size() + right->size())
+{
+}
+
+Rope::~Rope()
+{
+    release(std::move(left), std::move(right));
+}
+
+size_t Rope::size() const
+{
+    return length;
+}
+
+const std::string &Rope::flatten()
+{
+    if (!left) {
+        return str;
+    }
+
+    str.reserve(length);
+    // Walk the leaves left to right with an explicit stack, since the tree is
+    // typically a long left-leaning chain
+    std::vector<Rope *> pending = {right.get(), left.get()};
+    while (!pending.empty()) {
+        Rope *node = pending.back();
+        pending.pop_back();
+        if (node->left) {
+            pending.push_back(node->right.get());
+            pending.push_back(node->left.get());
+        } else {
+            str += node->str;
+        }
+    }
+
+    release(std::move(left), std::move(right));
+    return str;
+}
+
+void Rope::release(std::shared_ptr<Rope> left, std::shared_ptr<Rope> right)
+{
+    std::vector<std::shared_ptr<Rope>> pending = {std::move(left), std::move(right)};
+    while (!pending.empty()) {
+        auto node = std::move(pending.back());
+        pending.pop_back();
+        // Only take the children of nodes we're the last owner of, shared
+        // subtrees are still referenced elsewhere
+        if (node && node.use_count() == 1) {
+            pending.push_back(std::move(node->left));
+            pending.push_back(std::move(node->right));
+        }
+    }
+}
+
+std::any concatenate(const std::any &a, const std::any &b)
+{
+    const bool a_rope = a.type() == typeid(std::shared_ptr<Rope>);
+    const bool b_rope = b.type() == typeid(std::shared_ptr<Rope>);
+    if (!a_rope && !b_rope) {
+        const auto &a_str = std::any_cast<const std::string &>(a);
+        const auto &b_str = std::any_cast<const std::string &>(b);
+        if (a_str.size() + b_str.size() < ROPE_MIN_LENGTH) {
+            return a_str + b_str;
+        }
+    }
+
+    auto a_node = a_rope ? std::any_cast<std::shared_ptr<Rope>>(a)
+                         : std::make_shared<Rope>(std::any_cast<const std::string &>(a));
+    auto b_node = b_rope ? std::any_cast<std::shared_ptr<Rope>>(b)
+                         : std::make_shared<Rope>(std::any_cast<const std::string &>(b));
+    return std::make_shared<Rope>(a_node, b_node);
+}
+
+bool is_string(const std::any &val)
+{
+    return val.type() == typeid(std::string) || val.type() == typeid(std::shared_ptr<Rope>);
+}
+
+const std::string &as_string(const std::any &val)
+{
+    if (val.type() == typeid(std::shared_ptr<Rope>)) {
+        return std::any_cast<const std::shared_ptr<Rope> &>(val)->flatten();
+    }
+    return std::any_cast<const std::string &>(val);
+}
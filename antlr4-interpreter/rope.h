@@ -0,0 +1,48 @@
+#pragma once
+
+#include <any>
+#include <memory>
+#include <string>
+
+// Concatenations shorter than this are done directly on std::string, longer ones
+// build a Rope
+const size_t ROPE_MIN_LENGTH = 64;
+
+// A lazily concatenated string. Concatenating two ropes is O(1), the pieces are
+// only copied into a single string when the value is observed (printed, compared
+// or passed to a native function). The flattened string is cached and the pieces
+// released, so a rope is flattened at most once.
+class Rope {
+    std::string str;
+    std::shared_ptr<Rope> left, right;
+    size_t length = 0;
+
+public:
+    Rope(const std::string &str);
+
+    Rope(const std::shared_ptr<Rope> &left, const std::shared_ptr<Rope> &right);
+
+    // Ropes built in a loop can be very deep, so they're released iteratively
+    // instead of recursing through the shared_ptr destructors
+    ~Rope();
+
+    Rope(const Rope &r) = delete;
+    Rope &operator=(const Rope &r) = delete;
+
+    size_t size() const;
+
+    const std::string &flatten();
+
+private:
+    static void release(std::shared_ptr<Rope> left, std::shared_ptr<Rope> right);
+};
+
+// Concatenate the two string values, returning either a std::string or a
+// std::shared_ptr<Rope> depending on the length of the result
+std::any concatenate(const std::any &a, const std::any &b);
+
+// Check if the value holds a string, either flat or as a rope
+bool is_string(const std::any &val);
+
+// Get the string held by the value, flattening it first if it's a rope
+const std::string &as_string(const std::any &val);
@@ -0,0 +1,148 @@
+#include "scanner_token_source.h"
+#include "LoxLexer.h"
+
+using namespace loxgrammar;
+
+ScannerTokenSource::ScannerTokenSource(std::string_view source, ErrorReporter &errors)
+    : scanner(source, errors)
+{
+}
+
+std::unique_ptr<antlr4::Token> ScannerTokenSource::nextToken()
+{
+    Token t = scanner.next_token();
+    const size_t start = t.type == TokenType::END_OF_FILE ? scanner.current : scanner.start;
+    const size_t stop = t.type == TokenType::END_OF_FILE ? start - 1 : scanner.current - 1;
+
+    auto token = std::make_unique<antlr4::CommonToken>(
+        std::pair<antlr4::TokenSource *, antlr4::CharStream *>(this, nullptr),
+        lox_lexer_type(t.type),
+        antlr4::Token::DEFAULT_CHANNEL,
+        start,
+        stop);
+    token->setText(t.type == TokenType::END_OF_FILE ? "<EOF>" : t.lexeme);
+    token->setLine(t.line);
+    token->setCharPositionInLine(column(start));
+    return token;
+}
+
+size_t ScannerTokenSource::getLine() const
+{
+    return scanner.line;
+}
+
+size_t ScannerTokenSource::getCharPositionInLine()
+{
+    return column(scanner.current);
+}
+
+antlr4::CharStream *ScannerTokenSource::getInputStream()
+{
+    return nullptr;
+}
+
+std::string ScannerTokenSource::getSourceName()
+{
+    return antlr4::IntStream::UNKNOWN_SOURCE_NAME;
+}
+
+antlr4::Ref<antlr4::TokenFactory<antlr4::CommonToken>> ScannerTokenSource::getTokenFactory()
+{
+    return antlr4::CommonTokenFactory::DEFAULT;
+}
+
+size_t ScannerTokenSource::column(size_t start)
+{
+    if (start > searched) {
+        const auto skipped = scanner.source.substr(searched, start - searched);
+        const size_t newline = skipped.rfind('\n');
+        if (newline != std::string_view::npos) {
+            line_start = searched + newline + 1;
+        }
+        searched = start;
+    }
+    return start - line_start;
+}
+
+size_t lox_lexer_type(TokenType type)
+{
+    switch (type) {
+    case TokenType::LEFT_PAREN:
+        return LoxLexer::LEFT_PAREN;
+    case TokenType::RIGHT_PAREN:
+        return LoxLexer::RIGHT_PAREN;
+    case TokenType::LEFT_BRACE:
+        return LoxLexer::LEFT_BRACE;
+    case TokenType::RIGHT_BRACE:
+        return LoxLexer::RIGHT_BRACE;
+    case TokenType::COMMA:
+        return LoxLexer::COMMA;
+    case TokenType::DOT:
+        return LoxLexer::PERIOD;
+    case TokenType::MINUS:
+        return LoxLexer::MINUS;
+    case TokenType::PLUS:
+        return LoxLexer::PLUS;
+    case TokenType::SEMICOLON:
+        return LoxLexer::SEMICOLON;
+    case TokenType::SLASH:
+        return LoxLexer::SLASH;
+    case TokenType::STAR:
+        return LoxLexer::STAR;
+    case TokenType::BANG:
+        return LoxLexer::BANG;
+    case TokenType::BANG_EQUAL:
+        return LoxLexer::NOT_EQUAL;
+    case TokenType::EQUAL:
+        return LoxLexer::EQUAL;
+    case TokenType::EQUAL_EQUAL:
+        return LoxLexer::EQUAL_EQUAL;
+    case TokenType::GREATER:
+        return LoxLexer::GREATER;
+    case TokenType::GREATER_EQUAL:
+        return LoxLexer::GREATER_EQUAL;
+    case TokenType::LESS:
+        return LoxLexer::LESS;
+    case TokenType::LESS_EQUAL:
+        return LoxLexer::LESS_EQUAL;
+    case TokenType::IDENTIFIER:
+    case TokenType::SUPER:
+    case TokenType::THIS:
+        return LoxLexer::IDENTIFIER;
+    case TokenType::STRING:
+        return LoxLexer::STRING;
+    case TokenType::NUMBER:
+        return LoxLexer::NUMBER;
+    case TokenType::AND:
+        return LoxLexer::AND;
+    case TokenType::CLASS:
+        return LoxLexer::CLASS;
+    case TokenType::ELSE:
+        return LoxLexer::ELSE;
+    case TokenType::FALSE:
+        return LoxLexer::FALSE;
+    case TokenType::FUN:
+        return LoxLexer::FUN;
+    case TokenType::FOR:
+        return LoxLexer::FOR;
+    case TokenType::IF:
+        return LoxLexer::IF;
+    case TokenType::NIL:
+        return LoxLexer::NIL;
+    case TokenType::OR:
+        return LoxLexer::OR;
+    case TokenType::PRINT:
+        return LoxLexer::PRINT;
+    case TokenType::RETURN:
+        return LoxLexer::RETURN;
+    case TokenType::TRUE:
+        return LoxLexer::TRUE;
+    case TokenType::VAR:
+        return LoxLexer::VAR;
+    case TokenType::WHILE:
+        return LoxLexer::WHILE;
+    case TokenType::END_OF_FILE:
+        break;
+    }
+    return antlr4::Token::EOF;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include "antlr4-runtime.h"
+#include "error_reporter.h"
+#include "scanner.h"
+
+// Feeds the tokens of the hand-written scanner from the tree-walking interpreter
+// to the ANTLR parser, translated to the LoxLexer vocabulary, so ANTLR is only
+// used for parsing. The source must outlive the token source and the tokens.
+class ScannerTokenSource : public antlr4::TokenSource {
+    Scanner scanner;
+    // The offset of the start of the line the last token started on, and how
+    // far back the source has been searched for it
+    size_t line_start = 0;
+    size_t searched = 0;
+
+public:
+    ScannerTokenSource(std::string_view source, ErrorReporter &errors);
+
+    std::unique_ptr<antlr4::Token> nextToken() override;
+
+    size_t getLine() const override;
+
+    size_t getCharPositionInLine() override;
+
+    // There's no ANTLR char stream behind the tokens, they carry their own text
+    antlr4::CharStream *getInputStream() override;
+
+    std::string getSourceName() override;
+
+    antlr4::Ref<antlr4::TokenFactory<antlr4::CommonToken>> getTokenFactory() override;
+
+private:
+    // The column of the token starting at the offset, tokens are requested in
+    // order so the source is only searched for newlines once
+    size_t column(size_t start);
+};
+
+// Get the LoxLexer token type for the scanner's token type. The ANTLR grammar
+// doesn't have this or super, the LoxLexer scans them as identifiers
+size_t lox_lexer_type(TokenType type);
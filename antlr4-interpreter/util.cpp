@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include <string>
 #include "antlr4-runtime.h"
+#include "rope.h"
 
 bool had_error = false;
 
@@ -60,7 +61,7 @@ std::string pretty_type_name(const std::type_info &t)
     if (t == typeid(float)) {
         return "float";
     }
-    if (t == typeid(StringPtr)) {
+    if (t == typeid(StringPtr) || t == typeid(std::shared_ptr<Rope>)) {
         return "string";
     }
     if (t == typeid(bool)) {
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Times the phases of a frontend_bench run and reports them, along with the
+// process's peak RSS after each phase, as one line of JSON for compare.py
+class BenchReport {
+    struct Phase {
+        std::string name;
+        double ms;
+        long peak_rss_kb;
+    };
+
+    std::string frontend;
+    std::vector<Phase> phases;
+
+public:
+    BenchReport(const std::string &frontend) : frontend(frontend) {}
+
+    // Run the phase, returning its result, references are returned as they are
+    template <typename Fn>
+    decltype(auto) time(const std::string &name, Fn fn)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        struct Record {
+            BenchReport &report;
+            const std::string &name;
+            std::chrono::steady_clock::time_point start;
+
+            ~Record()
+            {
+                const std::chrono::duration<double, std::milli> ms =
+                    std::chrono::steady_clock::now() - start;
+                report.phases.push_back(Phase{name, ms.count(), peak_rss_kb()});
+            }
+        } record{*this, name, start};
+        return fn();
+    }
+
+    void print(std::ostream &os,
+               const std::string &file,
+               size_t bytes,
+               size_t tokens,
+               size_t nodes) const
+    {
+        os << "{\"frontend\": \"" << frontend << "\", \"file\": \"" << file
+           << "\", \"bytes\": " << bytes << ", \"tokens\": " << tokens
+           << ", \"nodes\": " << nodes << ", \"phases\": [";
+        for (size_t i = 0; i < phases.size(); ++i) {
+            os << (i > 0 ? ", " : "") << "{\"name\": \"" << phases[i].name
+               << "\", \"ms\": " << phases[i].ms
+               << ", \"peak_rss_kb\": " << phases[i].peak_rss_kb << "}";
+        }
+        os << "]}\n";
+    }
+
+    static long peak_rss_kb()
+    {
+#if defined(__linux__)
+        // ru_maxrss is carried over exec from the parent, so if we were started
+        // by a larger process (e.g. compare.py) it would report the parent's
+        // peak. The high water mark in /proc starts over with the new image
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.rfind("VmHWM:", 0) == 0) {
+                return std::stol(line.substr(6));
+            }
+        }
+        return 0;
+#elif !defined(_WIN32)
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+#else
+        return 0;
+#endif
+    }
+};
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# Compare the front-ends on a corpus from gen_corpus.py, e.g.
+#
+#   ./gen_corpus.py corpus 10M
+#   ./compare.py --bench ../interpreter/build/frontend_bench \
+#       --bench ../antlr4-interpreter/build/frontend_bench \
+#       --bench "../antlr4-interpreter/build/frontend_bench --antlr-lexer" corpus/*.lox
+#
+# Each bench command is run on each script, reporting lexing and parsing
+# throughput, the time of each phase and the peak RSS.
+import argparse
+import json
+import shlex
+import subprocess
+import sys
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--bench", action="append", required=True,
+                    help="frontend_bench command to run, with any flags")
+parser.add_argument("--repeat", type=int, default=3,
+                    help="runs of each script, the fastest is reported")
+parser.add_argument("scripts", nargs="+")
+args = parser.parse_args()
+
+
+def run(command, script):
+    best = None
+    for _ in range(args.repeat):
+        result = subprocess.run(shlex.split(command) + [script], stdout=subprocess.PIPE)
+        if result.returncode != 0:
+            print("{} failed on {}".format(command, script), file=sys.stderr)
+            return None
+        report = json.loads(result.stdout.decode("utf-8"))
+        total = sum(p["ms"] for p in report["phases"])
+        if best is None or total < best[0]:
+            best = (total, report)
+    return best[1]
+
+
+def phase(report, name):
+    return next((p for p in report["phases"] if p["name"] == name), {"ms": 0, "peak_rss_kb": 0})
+
+
+def per_sec(count, ms):
+    return count / (ms / 1000) if ms > 0 else 0
+
+
+header = ["frontend", "bytes", "tokens", "nodes", "Mtok/s", "Mnode/s",
+          "read ms", "lex ms", "parse ms", "resolve ms", "peak MB"]
+rows = []
+for script in sorted(args.scripts, key=lambda s: len(open(s, "rb").read())):
+    for command in args.bench:
+        report = run(command, script)
+        if not report:
+            continue
+        lex = phase(report, "lex")
+        parse = phase(report, "parse")
+        peak = max(p["peak_rss_kb"] for p in report["phases"])
+        rows.append([
+            report["frontend"],
+            str(report["bytes"]),
+            str(report["tokens"]),
+            str(report["nodes"]),
+            "{:.2f}".format(per_sec(report["tokens"], lex["ms"]) / 1e6),
+            "{:.2f}".format(per_sec(report["nodes"], parse["ms"]) / 1e6),
+            "{:.2f}".format(phase(report, "read")["ms"]),
+            "{:.2f}".format(lex["ms"]),
+            "{:.2f}".format(parse["ms"]),
+            "{:.2f}".format(phase(report, "resolve")["ms"]),
+            "{:.1f}".format(peak / 1024),
+        ])
+
+widths = [max(len(r[i]) for r in rows + [header]) for i in range(len(header))]
+print("  ".join(h.rjust(w) for h, w in zip(header, widths)))
+for r in rows:
+    print("  ".join(c.rjust(w) for c, w in zip(r, widths)))
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# Generate synthetic Lox programs of increasing size for frontend_bench. The
+# programs only use syntax both front-ends accept (at most two parameters, no
+# this or super) and don't declare unused locals, so the resolver is quiet.
+import sys
+import os
+
+SIZES = [
+    ("1K", 1 << 10),
+    ("10K", 10 << 10),
+    ("100K", 100 << 10),
+    ("1M", 1 << 20),
+    ("10M", 10 << 20),
+    ("100M", 100 << 20),
+]
+
+UNIT = """fun f{i}(a, b) {{
+    var c = a * b + {i};
+    if (c > 10 and a != b) {{
+        c = c - (a / 2);
+    }} else {{
+        c = -c;
+    }}
+    return c;
+}}
+class C{i} {{
+    get(x) {{
+        return x + 1;
+    }}
+}}
+var v{i} = f{i}({i}, 2.5);
+for (var j = 0; j < 3; j = j + 1) {{
+    v{i} = v{i} + j;
+}}
+while (v{i} > 100) v{i} = v{i} / 2;
+print v{i} == nil or !(v{i} <= 3);
+var o{i} = C{i}();
+o{i}.field = "text {i}";
+print o{i}.field + " done";
+// Unit {i}
+"""
+
+def generate(path, size):
+    written = 0
+    i = 0
+    with open(path, "w") as f:
+        while written < size:
+            unit = UNIT.format(i=i)
+            f.write(unit)
+            written += len(unit)
+            i += 1
+
+if len(sys.argv) > 3:
+    print("Usage: gen_corpus.py [output dir] [max size, e.g. 10M]")
+    sys.exit(1)
+
+out_dir = sys.argv[1] if len(sys.argv) > 1 else "corpus"
+max_size = dict(SIZES)[sys.argv[2]] if len(sys.argv) > 2 else SIZES[-1][1]
+os.makedirs(out_dir, exist_ok=True)
+for name, size in SIZES:
+    if size <= max_size:
+        path = os.path.join(out_dir, "corpus_{}.lox".format(name))
+        generate(path, size)
+        print(path)
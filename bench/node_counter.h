@@ -0,0 +1,150 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "expr.h"
+
+// Counts the nodes of an AST, for frontend_bench. Both front-ends generate the
+// same node types, so this builds against either tree's expr.h
+struct NodeCounter : Expr::Visitor, Stmt::Visitor {
+    size_t nodes = 0;
+
+    size_t count(const std::vector<std::shared_ptr<Stmt>> &statements)
+    {
+        for (const auto &s : statements) {
+            count(s);
+        }
+        return nodes;
+    }
+
+    template <typename T>
+    void count(const std::shared_ptr<T> &node)
+    {
+        if (node) {
+            node->accept(*this);
+        }
+    }
+
+    void visit(const Assign &a) override
+    {
+        ++nodes;
+        count(a.value);
+    }
+
+    void visit(const Binary &b) override
+    {
+        ++nodes;
+        count(b.left);
+        count(b.right);
+    }
+
+    void visit(const Call &c) override
+    {
+        ++nodes;
+        count(c.callee);
+        for (const auto &a : c.args) {
+            count(a);
+        }
+    }
+
+    void visit(const Grouping &g) override
+    {
+        ++nodes;
+        count(g.expr);
+    }
+
+    void visit(const Literal &) override
+    {
+        ++nodes;
+    }
+
+    void visit(const Logical &l) override
+    {
+        ++nodes;
+        count(l.left);
+        count(l.right);
+    }
+
+    void visit(const Unary &u) override
+    {
+        ++nodes;
+        count(u.expr);
+    }
+
+    void visit(const Variable &) override
+    {
+        ++nodes;
+    }
+
+    void visit(const Get &g) override
+    {
+        ++nodes;
+        count(g.object);
+    }
+
+    void visit(const Set &s) override
+    {
+        ++nodes;
+        count(s.object);
+        count(s.value);
+    }
+
+    void visit(const Block &b) override
+    {
+        ++nodes;
+        count(b.statements);
+    }
+
+    void visit(const Expression &e) override
+    {
+        ++nodes;
+        count(e.expr);
+    }
+
+    void visit(const Class &c) override
+    {
+        ++nodes;
+        for (const auto &m : c.methods) {
+            count(m);
+        }
+    }
+
+    void visit(const If &f) override
+    {
+        ++nodes;
+        count(f.condition);
+        count(f.then_branch);
+        count(f.else_branch);
+    }
+
+    void visit(const Print &p) override
+    {
+        ++nodes;
+        count(p.expr);
+    }
+
+    void visit(const Var &v) override
+    {
+        ++nodes;
+        count(v.initializer);
+    }
+
+    void visit(const While &w) override
+    {
+        ++nodes;
+        count(w.condition);
+        count(w.body);
+    }
+
+    void visit(const Function &f) override
+    {
+        ++nodes;
+        count(f.body);
+    }
+
+    void visit(const Return &r) override
+    {
+        ++nodes;
+        count(r.value);
+    }
+};
@@ -1,5 +1,6 @@
 #include "ast_printer.h"
 #include <iostream>
+#include "number.h"
 
 const std::string &ASTPrinter::print(const Expr &expr)
 {
@@ -19,7 +20,7 @@ void ASTPrinter::visit(const Literal &l)
 {
     if (l.value.has_value()) {
         if (l.value.type() == typeid(float)) {
-            text += std::to_string(std::any_cast<float>(l.value));
+            text += format_number(std::any_cast<float>(l.value));
         } else if (l.value.type() == typeid(std::string)) {
             text += std::any_cast<std::string>(l.value);
         } else if (l.value.type() == typeid(bool)) {
@@ -166,9 +167,13 @@ void ProgramPrinter::visit(const Function &v)
         }
     }
     text += ")\n BODY:\n";
-    ProgramPrinter printer;
-    printer.print({v.body});
-    text += printer.text + "}";
+    if (v.body) {
+        ProgramPrinter printer;
+        printer.print({v.body});
+        text += printer.text + "}";
+    } else {
+        text += "<deferred>\n}";
+    }
 }
 
 void ProgramPrinter::visit(const Return &r)
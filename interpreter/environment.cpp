@@ -4,12 +4,17 @@
 
 Environment::Environment(std::shared_ptr<Environment> &enclosing) : enclosing(enclosing) {}
 
-void Environment::define(const std::string &name, const std::any &val)
+void Environment::define(Symbol name, const std::any &val)
 {
     values[name] = val;
 }
 
-void Environment::assign(const std::string &name, const std::any &val)
+void Environment::define(const std::string &name, const std::any &val)
+{
+    define(intern(name), val);
+}
+
+void Environment::assign(Symbol name, const std::any &val)
 {
     auto fnd = values.find(name);
     if (fnd != values.end()) {
@@ -17,22 +22,22 @@ void Environment::assign(const std::string &name, const std::any &val)
     } else if (enclosing) {
         enclosing->assign(name, val);
     } else {
-        throw std::runtime_error("Undefined variable '" + name + "'");
+        throw std::runtime_error("Undefined variable '" + symbol_name(name) + "'");
     }
 }
 
-void Environment::assign_at(const size_t depth, const std::string &name, const std::any &val)
+void Environment::assign_at(const size_t depth, Symbol name, const std::any &val)
 {
     auto &a = ancestor(depth);
     auto fnd = a.values.find(name);
-    if (fnd != values.end()) {
+    if (fnd != a.values.end()) {
         fnd->second = val;
     } else {
-        throw std::runtime_error("Undefined variable '" + name + "'");
+        throw std::runtime_error("Undefined variable '" + symbol_name(name) + "'");
     }
 }
 
-std::any Environment::get(const std::string &name) const
+std::any Environment::get(Symbol name) const
 {
     auto fnd = values.find(name);
     if (fnd != values.end()) {
@@ -40,20 +45,38 @@ std::any Environment::get(const std::string &name) const
     } else if (enclosing) {
         return enclosing->get(name);
     }
-    throw std::runtime_error("Undefined variable '" + name + "'");
+    throw std::runtime_error("Undefined variable '" + symbol_name(name) + "'");
 }
 
-std::any Environment::get_at(const size_t depth, const std::string &name) const
+std::any Environment::get_at(const size_t depth, Symbol name) const
 {
     const auto &a = ancestor(depth);
     auto fnd = a.values.find(name);
-    if (fnd != values.end()) {
+    if (fnd != a.values.end()) {
         return fnd->second;
     } else {
-        throw std::runtime_error("Undefined variable '" + name + "'");
+        throw std::runtime_error("Undefined variable '" + symbol_name(name) + "'");
     }
 }
 
+const std::any *Environment::find(Symbol name) const
+{
+    auto fnd = values.find(name);
+    if (fnd != values.end()) {
+        return &fnd->second;
+    } else if (enclosing) {
+        return enclosing->find(name);
+    }
+    return nullptr;
+}
+
+const std::any *Environment::find_at(const size_t depth, Symbol name) const
+{
+    const auto &a = ancestor(depth);
+    auto fnd = a.values.find(name);
+    return fnd != a.values.end() ? &fnd->second : nullptr;
+}
+
 const Environment &Environment::ancestor(const size_t depth) const
 {
     // Step back up the environments to the specified depth
@@ -4,10 +4,11 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include "symbol.h"
 
 class Environment {
     std::shared_ptr<Environment> enclosing;
-    std::unordered_map<std::string, std::any> values;
+    std::unordered_map<Symbol, std::any> values;
 
 public:
     Environment(std::shared_ptr<Environment> &enclosing);
@@ -17,15 +18,23 @@ public:
     Environment(const Environment &e) = delete;
     Environment &operator=(const Environment &e) = delete;
 
+    void define(Symbol name, const std::any &val);
+
+    // Define the variable by name, used to set up the globals
     void define(const std::string &name, const std::any &val);
 
-    void assign(const std::string &name, const std::any &val);
+    void assign(Symbol name, const std::any &val);
+
+    void assign_at(const size_t depth, Symbol name, const std::any &val);
+
+    std::any get(Symbol name) const;
 
-    void assign_at(const size_t depth, const std::string &name, const std::any &val);
+    std::any get_at(const size_t depth, Symbol name) const;
 
-    std::any get(const std::string &name) const;
+    // Find the variable without copying it, returns nullptr if it's undefined
+    const std::any *find(Symbol name) const;
 
-    std::any get_at(const size_t depth, const std::string &name) const;
+    const std::any *find_at(const size_t depth, Symbol name) const;
 
 private:
     const Environment &ancestor(const size_t depth) const;
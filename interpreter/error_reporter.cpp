@@ -0,0 +1,35 @@
+#include "error_reporter.h"
+#include <iostream>
+
+ErrorReporter::ErrorReporter() : stream(&std::cerr) {}
+
+ErrorReporter::ErrorReporter(std::ostream &stream) : stream(&stream) {}
+
+void ErrorReporter::report(int line, const std::string &where, const std::string &msg)
+{
+    // Write each message in one call so messages from isolates sharing a stream
+    // don't get interleaved
+    *stream << "[line " + std::to_string(line) + "] Error " + where + ": " + msg + "\n";
+}
+
+void ErrorReporter::error(int line, const std::string &msg)
+{
+    had_error = true;
+    report(line, "", msg);
+}
+
+void ErrorReporter::error(const Token &t, const std::string &msg)
+{
+    had_error = true;
+    if (t.type == TokenType::END_OF_FILE) {
+        report(t.line, " at end of file", msg);
+    } else {
+        report(t.line, " at '" + t.lexeme + "'", msg);
+    }
+}
+
+void ErrorReporter::warning(const std::string &msg)
+{
+    had_warning = true;
+    *stream << "Warning: " + msg + "\n";
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include "token.h"
+
+// Reports the compile and runtime errors of a script and tracks whether there
+// were any. Each isolate has its own reporter, so scripts running on different
+// threads don't share any error state.
+struct ErrorReporter {
+    bool had_error = false;
+    bool had_warning = false;
+    std::ostream *stream;
+
+    // Report errors to std::cerr
+    ErrorReporter();
+
+    ErrorReporter(std::ostream &stream);
+
+    void report(int line, const std::string &where, const std::string &msg);
+
+    void error(int line, const std::string &msg);
+
+    void error(const Token &t, const std::string &msg);
+
+    void warning(const std::string &msg);
+};
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "bench_report.h"
+#include "error_reporter.h"
+#include "mapped_file.h"
+#include "node_counter.h"
+#include "parser.h"
+#include "program.h"
+#include "resolver.h"
+#include "scanner.h"
+
+// Runs a script through the scanner, parser and resolver without evaluating it,
+// reporting the time and peak memory of each phase. See bench/compare.py
+int main(int argc, char **argv)
+{
+    std::string script;
+    bool lazy_functions = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--lazy") {
+            lazy_functions = true;
+        } else if (script.empty() && arg.rfind("--", 0) != 0) {
+            script = arg;
+        } else {
+            script.clear();
+            break;
+        }
+    }
+    if (script.empty()) {
+        std::cerr << "Usage: frontend_bench [--lazy] script\n";
+        return 1;
+    }
+
+    try {
+        BenchReport report(lazy_functions ? "handwritten-lazy" : "handwritten");
+        ErrorReporter errors;
+
+        std::optional<MappedFile> file;
+        std::string_view source;
+        report.time("read", [&] {
+            file.emplace(script);
+            source = file->data();
+            // Touch every page so faulting in the mapping isn't counted as lexing
+            volatile char sink = 0;
+            for (size_t i = 0; i < source.size(); i += 4096) {
+                sink = sink + source[i];
+            }
+        });
+
+        Scanner scanner(source, errors);
+        const auto &tokens = report.time("lex", [&]() -> const std::vector<Token> & {
+            return scanner.scan_tokens();
+        });
+
+        auto program = std::make_shared<Program>();
+        report.time("parse", [&] {
+            Parser parser(tokens, errors, lazy_functions);
+            program->statements = parser.parse();
+            program->deferred_bodies = std::move(parser.deferred_bodies);
+        });
+
+        report.time("resolve", [&] {
+            Resolver resolver(errors);
+            resolver.resolve(*program);
+        });
+
+        NodeCounter counter;
+        report.print(std::cout,
+                     script,
+                     source.size(),
+                     tokens.size(),
+                     counter.count(program->statements));
+        return errors.had_error ? 1 : 0;
+    } catch (const std::runtime_error &e) {
+        std::cerr << "frontend_bench: " << e.what() << "\n";
+        return 1;
+    }
+}
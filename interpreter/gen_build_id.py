@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+# Writes a header defining LOX_BUILD_ID, a hash of the given source files. The
+# compile cache stores it so programs cached by another build aren't loaded
+import hashlib
+import os
+import sys
+
+if len(sys.argv) < 2:
+    print("Usage: gen_build_id.py <output header> <source files>")
+    sys.exit(1)
+
+digest = hashlib.sha256()
+for path in sorted(sys.argv[2:], key=os.path.basename):
+    digest.update(os.path.basename(path).encode("utf-8") + b"\0")
+    with open(path, "rb") as f:
+        digest.update(f.read())
+    digest.update(b"\0")
+
+build_id = digest.hexdigest()[:16]
+header = ("#pragma once\n\n"
+          "// Generated by gen_build_id.py from the sources of liblox\n"
+          "#define LOX_BUILD_ID 0x{}ull\n".format(build_id))
+
+# Only write the header when the ID changes, so what includes it isn't rebuilt
+output = sys.argv[1]
+if os.path.exists(output):
+    with open(output, "r") as f:
+        if f.read() == header:
+            sys.exit(0)
+with open(output, "w") as f:
+    f.write(header)
@@ -1,7 +1,10 @@
 #include "interpreter.h"
-#include <iostream>
 #include "lox_callable.h"
 #include "lox_class.h"
+#include "native.h"
+#include "number.h"
+#include "rope.h"
+#include "type_feedback.h"
 #include "util.h"
 
 InterpreterError::InterpreterError(const Token &t, const std::string &msg)
@@ -11,7 +14,47 @@ InterpreterError::InterpreterError(const Token &t, const std::string &msg)
 
 ReturnControlFlow::ReturnControlFlow(const std::any &value) : value(value) {}
 
-void Interpreter::evaluate(const std::vector<std::shared_ptr<Stmt>> &statements)
+ProgramScope::ProgramScope(const Program *&current, const Program *program)
+    : current(current), prev(current)
+{
+    current = program;
+}
+
+ProgramScope::~ProgramScope()
+{
+    current = prev;
+}
+
+FeedbackScope::FeedbackScope(TypeFeedback *&current, TypeFeedback *feedback)
+    : current(current), prev(current)
+{
+    current = feedback;
+}
+
+FeedbackScope::~FeedbackScope()
+{
+    current = prev;
+}
+
+CallFrame::CallFrame(std::vector<std::any> &args, size_t &depth) : args(args), depth(depth)
+{
+    ++depth;
+}
+
+CallFrame::~CallFrame()
+{
+    // Release the argument values but keep the vector's storage for the next call
+    args.clear();
+    --depth;
+}
+
+bool Interpreter::evaluate(const std::shared_ptr<const Program> &program)
+{
+    ProgramScope scope(this->program, program.get());
+    return evaluate(program->statements);
+}
+
+bool Interpreter::evaluate(const std::vector<std::shared_ptr<Stmt>> &statements)
 {
     result = std::any();
     try {
@@ -20,8 +63,10 @@ void Interpreter::evaluate(const std::vector<std::shared_ptr<Stmt>> &statements)
             result = std::any();
         }
     } catch (const InterpreterError &e) {
-        error(e.token, e.message);
+        errors.error(e.token, e.message);
+        return false;
     }
+    return true;
 }
 
 const std::any &Interpreter::evaluate(const Expr &expr)
@@ -31,9 +76,19 @@ const std::any &Interpreter::evaluate(const Expr &expr)
     return result;
 }
 
-Interpreter::Interpreter()
-    : float_id(std::type_index(typeid(float))),
+Interpreter::Interpreter() : Interpreter(make_stdout_sink()) {}
+
+Interpreter::Interpreter(const std::shared_ptr<OutputSink> &output)
+    : Interpreter(output, ErrorReporter())
+{
+}
+
+Interpreter::Interpreter(const std::shared_ptr<OutputSink> &output, const ErrorReporter &errors)
+    : output(output),
+      errors(errors),
+      float_id(std::type_index(typeid(float))),
       string_id(std::type_index(typeid(std::string))),
+      rope_id(std::type_index(typeid(std::shared_ptr<Rope>))),
       bool_id(std::type_index(typeid(bool))),
       nil_id(std::type_index(typeid(void))),
       callable_id(std::type_index(typeid(std::shared_ptr<LoxCallable>)))
@@ -44,9 +99,10 @@ Interpreter::Interpreter()
     type_names[nil_id] = pretty_type_name(typeid(void));
 
     // Populate the global environment with native functions
-    globals->define("clock", std::shared_ptr<LoxCallable>(std::make_shared<Clock>()));
-    globals->define("_ci_test_add",
-                    std::shared_ptr<LoxCallable>(std::make_shared<CITestAdd>()));
+    register_native("clock", native_clock);
+    register_native("_ci_test_add", native_ci_test_add);
+    globals->define("StringBuilder",
+                    std::shared_ptr<LoxCallable>(std::make_shared<StringBuilder>()));
 }
 
 void Interpreter::visit(const Grouping &g)
@@ -61,117 +117,33 @@ void Interpreter::visit(const Literal &l)
 
 void Interpreter::visit(const Unary &u)
 {
-    std::any right = evaluate(*u.expr);
-    switch (u.op.type) {
-    case TokenType::MINUS:
-        check_type(right, {float_id}, u.op);
-        result = -std::any_cast<float>(right);
-        break;
-    case TokenType::BANG:
-        result = !is_true(right);
-        break;
-    default:
-        break;
-    }
+    result = unary(u.op, evaluate(*u.expr));
 }
 
 void Interpreter::visit(const Binary &b)
 {
     std::any left = evaluate(*b.left);
     std::any right = evaluate(*b.right);
-
-    switch (b.op.type) {
-    case TokenType::PLUS:
-        check_type(right, {float_id, string_id}, b.op);
-        check_type(left, {float_id, string_id}, b.op);
-        if (left.type() == typeid(float) && right.type() == typeid(float)) {
-            result = std::any_cast<float>(left) + std::any_cast<float>(right);
-        } else if (left.type() == typeid(std::string) && right.type() == typeid(std::string)) {
-            result = std::any_cast<std::string>(left) + std::any_cast<std::string>(right);
-        } else {
-            // We know one is a string and one is a float
-            if (left.type() == typeid(float)) {
-                result = std::to_string(std::any_cast<float>(left)) +
-                         std::any_cast<std::string>(right);
-            } else {
-                result = std::any_cast<std::string>(left) +
-                         std::to_string(std::any_cast<float>(right));
-            }
-        }
-        break;
-    case TokenType::MINUS:
-        check_same_type(left, right, b.op);
-        check_type(left, {float_id, string_id}, b.op);
-        result = std::any_cast<float>(left) - std::any_cast<float>(right);
-        break;
-    case TokenType::SLASH:
-        check_same_type(left, right, b.op);
-        check_type(left, {float_id}, b.op);
-        if (std::any_cast<float>(right) == 0.f) {
-            throw InterpreterError(b.op, "Division by 0");
-        }
-        result = std::any_cast<float>(left) / std::any_cast<float>(right);
-        break;
-    case TokenType::STAR:
-        check_same_type(left, right, b.op);
-        check_type(left, {float_id}, b.op);
-        result = std::any_cast<float>(left) * std::any_cast<float>(right);
-        break;
-    case TokenType::BANG_EQUAL:
-        result = !is_equal(left, right);
-        break;
-    case TokenType::EQUAL_EQUAL:
-        result = is_equal(left, right);
-        break;
-    case TokenType::GREATER:
-        check_same_type(left, right, b.op);
-        check_type(left, {float_id}, b.op);
-        result = std::any_cast<float>(left) > std::any_cast<float>(right);
-        break;
-    case TokenType::GREATER_EQUAL:
-        check_same_type(left, right, b.op);
-        check_type(left, {float_id}, b.op);
-        result = std::any_cast<float>(left) >= std::any_cast<float>(right);
-        break;
-    case TokenType::LESS:
-        check_same_type(left, right, b.op);
-        check_type(left, {float_id}, b.op);
-        result = std::any_cast<float>(left) < std::any_cast<float>(right);
-        break;
-    case TokenType::LESS_EQUAL:
-        check_same_type(left, right, b.op);
-        check_type(left, {float_id}, b.op);
-        result = std::any_cast<float>(left) <= std::any_cast<float>(right);
-        break;
-    default:
-        break;
+    if (feedback) {
+        feedback->record(b, left, right);
     }
+    result = binary(b.op, left, right);
 }
 
 void Interpreter::visit(const Call &c)
 {
     auto callee = evaluate(*c.callee);
-    std::vector<std::any> args;
-    for (const auto &e : c.args) {
-        args.push_back(evaluate(*e));
+    if (feedback) {
+        feedback->record(c, callee);
     }
 
-    std::shared_ptr<LoxCallable> fcn;
-    if (callee.type() == typeid(std::shared_ptr<LoxCallable>)) {
-        fcn = std::any_cast<std::shared_ptr<LoxCallable>>(callee);
-    } else if (callee.type() == typeid(std::shared_ptr<LoxClass>)) {
-        fcn = std::dynamic_pointer_cast<LoxCallable>(
-            std::any_cast<std::shared_ptr<LoxClass>>(callee));
-    } else {
-        throw InterpreterError(c.paren, "Only functions and classes are callable");
-    }
-
-    if (args.size() != fcn->arity()) {
-        throw InterpreterError(c.paren,
-                               "Expected " + std::to_string(fcn->arity()) +
-                                   " arguments but got " + std::to_string(args.size()));
+    // Nested calls while evaluating the arguments or running the function use the
+    // argument lists further down the stack
+    CallFrame frame = enter_call();
+    for (const auto &e : c.args) {
+        frame.args.push_back(evaluate(*e));
     }
-    result = fcn->call(*this, args);
+    result = call(callee, frame.args, c.paren);
 }
 
 void Interpreter::visit(const Logical &l)
@@ -202,11 +174,11 @@ void Interpreter::visit(const Assign &a)
 {
     result = evaluate(*a.value);
     try {
-        auto fnd = locals.find(&a);
-        if (fnd != locals.end()) {
-            environment->assign_at(fnd->second, a.name.lexeme, result);
+        auto fnd = program->locals.find(&a);
+        if (fnd != program->locals.end()) {
+            environment->assign_at(fnd->second, a.name.symbol, result);
         } else {
-            globals->assign(a.name.lexeme, result);
+            globals->assign(a.name.symbol, result);
         }
     } catch (const std::runtime_error &) {
         throw InterpreterError(a.name, "Undefined variable");
@@ -260,34 +232,32 @@ void Interpreter::visit(const If &f)
 
 void Interpreter::visit(const While &w)
 {
+    // Profile the loop for when it's compiled, unless it's in a function being
+    // profiled already
+    TypeFeedback loop_feedback;
+    const bool profile = jit.enabled && jit.speculate && !feedback;
+    FeedbackScope profiling(feedback, profile ? &loop_feedback : feedback);
+
+    size_t iterations = 0;
     while (is_true(evaluate(*w.condition))) {
         evaluate({w.body});
+        // Once the loop is hot replace it with compiled code, which continues
+        // from the next check of the condition
+        if (++iterations == jit.osr_threshold && jit.enabled) {
+            if (auto code = compile_loop(w)) {
+                FeedbackScope no_feedback(feedback, nullptr);
+                auto env = environment;
+                code->run(*this, env);
+                break;
+            }
+        }
     }
     result = std::any();
 }
 
 void Interpreter::visit(const Print &p)
 {
-    std::any val = evaluate(*p.expr);
-    if (val.has_value()) {
-        if (val.type() == typeid(float)) {
-            std::cout << std::any_cast<float>(val) << "\n";
-        } else if (val.type() == typeid(std::string)) {
-            std::cout << std::any_cast<std::string>(val) << "\n";
-        } else if (val.type() == typeid(bool)) {
-            std::cout << (std::any_cast<bool>(val) ? "true" : "false") << "\n";
-        } else if (val.type() == typeid(std::shared_ptr<LoxCallable>)) {
-            std::cout << std::any_cast<std::shared_ptr<LoxCallable>>(val)->to_string() << "\n";
-        } else if (val.type() == typeid(std::shared_ptr<LoxClass>)) {
-            std::cout << std::any_cast<std::shared_ptr<LoxClass>>(val)->to_string() << "\n";
-        } else if (val.type() == typeid(std::shared_ptr<LoxInstance>)) {
-            std::cout << std::any_cast<std::shared_ptr<LoxInstance>>(val)->to_string() << "\n";
-        } else {
-            std::cerr << "[error]: Unsupported val type!?\n";
-        }
-    } else {
-        std::cout << "nil";
-    }
+    print(evaluate(*p.expr));
     result = std::any();
 }
 
@@ -298,17 +268,23 @@ void Interpreter::visit(const Var &v)
         initializer = evaluate(*v.initializer);
     }
 
-    environment->define(v.token.lexeme, initializer);
+    environment->define(v.token.symbol, initializer);
 
     result = std::any();
 }
 
 void Interpreter::visit(const Function &f)
 {
-    // Now we will create and add a callable to the globals
-    environment->define(
-        f.name.lexeme,
-        std::shared_ptr<LoxCallable>(std::make_shared<LoxFunction>(f, environment)));
+    // Now we will create and add a callable to the globals. Top-level functions
+    // may have their bodies deferred until they're first called
+    std::shared_ptr<DeferredBody> deferred;
+    auto fnd = program->deferred_bodies.find(&f);
+    if (fnd != program->deferred_bodies.end()) {
+        deferred = fnd->second;
+    }
+    environment->define(f.name.symbol,
+                        std::shared_ptr<LoxCallable>(std::make_shared<LoxFunction>(
+                            f, environment, program->shared_from_this(), deferred)));
     result = std::any();
 }
 
@@ -323,9 +299,9 @@ void Interpreter::visit(const Return &r)
 
 void Interpreter::visit(const Class &c)
 {
-    environment->define(c.name.lexeme, std::any());
-    auto lox_class = std::make_shared<LoxClass>(c.name.lexeme);
-    environment->assign(c.name.lexeme, lox_class);
+    environment->define(c.name.symbol, std::any());
+    auto lox_class = std::make_shared<LoxClass>(c.name.symbol);
+    environment->assign(c.name.symbol, lox_class);
 }
 
 void Interpreter::execute_block(const std::vector<std::shared_ptr<Stmt>> &statements,
@@ -345,17 +321,150 @@ void Interpreter::execute_block(const std::vector<std::shared_ptr<Stmt>> &statem
     environment = prev;
 }
 
-void Interpreter::resolve(const Expr &expr, size_t depth)
+CallFrame Interpreter::enter_call()
+{
+    if (call_depth == call_args.size()) {
+        call_args.emplace_back();
+    }
+    return CallFrame(call_args[call_depth], call_depth);
+}
+
+std::any Interpreter::call(const std::any &callee, std::vector<std::any> &args, const Token &paren)
+{
+    std::shared_ptr<LoxCallable> fcn;
+    if (callee.type() == typeid(std::shared_ptr<LoxCallable>)) {
+        fcn = std::any_cast<std::shared_ptr<LoxCallable>>(callee);
+    } else if (callee.type() == typeid(std::shared_ptr<LoxClass>)) {
+        fcn = std::dynamic_pointer_cast<LoxCallable>(
+            std::any_cast<std::shared_ptr<LoxClass>>(callee));
+    } else {
+        throw InterpreterError(paren, "Only functions and classes are callable");
+    }
+
+    if (args.size() != fcn->arity()) {
+        throw InterpreterError(paren,
+                               "Expected " + std::to_string(fcn->arity()) +
+                                   " arguments but got " + std::to_string(args.size()));
+    }
+    return invoke(*fcn, args, paren);
+}
+
+std::any Interpreter::invoke(LoxCallable &fcn, std::vector<std::any> &args, const Token &paren)
+{
+    try {
+        return fcn.call(*this, args);
+    } catch (InterpreterError &e) {
+        if (e.token.line == 0 && e.token.lexeme.empty()) {
+            e.token = paren;
+        }
+        throw;
+    }
+}
+
+std::any Interpreter::unary(const Token &op, const std::any &right)
 {
-    locals[&expr] = depth;
+    switch (op.type) {
+    case TokenType::MINUS:
+        check_type(right, {float_id}, op);
+        return -std::any_cast<float>(right);
+    case TokenType::BANG:
+        return !is_true(right);
+    default:
+        return std::any();
+    }
 }
 
+std::any Interpreter::binary(const Token &op, std::any &left, std::any &right)
+{
+    switch (op.type) {
+    case TokenType::PLUS:
+        check_type(right, {float_id, string_id}, op);
+        check_type(left, {float_id, string_id}, op);
+        if (left.type() == typeid(float) && right.type() == typeid(float)) {
+            return std::any_cast<float>(left) + std::any_cast<float>(right);
+        } else {
+            // At least one is a string, and strings are concatenated lazily as ropes
+            if (left.type() == typeid(float)) {
+                left = format_number(std::any_cast<float>(left));
+            } else if (right.type() == typeid(float)) {
+                right = format_number(std::any_cast<float>(right));
+            }
+            return concatenate(left, right);
+        }
+    case TokenType::MINUS:
+        check_same_type(left, right, op);
+        check_type(left, {float_id, string_id}, op);
+        return std::any_cast<float>(left) - std::any_cast<float>(right);
+    case TokenType::SLASH:
+        check_same_type(left, right, op);
+        check_type(left, {float_id}, op);
+        if (std::any_cast<float>(right) == 0.f) {
+            throw InterpreterError(op, "Division by 0");
+        }
+        return std::any_cast<float>(left) / std::any_cast<float>(right);
+    case TokenType::STAR:
+        check_same_type(left, right, op);
+        check_type(left, {float_id}, op);
+        return std::any_cast<float>(left) * std::any_cast<float>(right);
+    case TokenType::BANG_EQUAL:
+        return !is_equal(left, right);
+    case TokenType::EQUAL_EQUAL:
+        return is_equal(left, right);
+    case TokenType::GREATER:
+        check_same_type(left, right, op);
+        check_type(left, {float_id}, op);
+        return std::any_cast<float>(left) > std::any_cast<float>(right);
+    case TokenType::GREATER_EQUAL:
+        check_same_type(left, right, op);
+        check_type(left, {float_id}, op);
+        return std::any_cast<float>(left) >= std::any_cast<float>(right);
+    case TokenType::LESS:
+        check_same_type(left, right, op);
+        check_type(left, {float_id}, op);
+        return std::any_cast<float>(left) < std::any_cast<float>(right);
+    case TokenType::LESS_EQUAL:
+        check_same_type(left, right, op);
+        check_type(left, {float_id}, op);
+        return std::any_cast<float>(left) <= std::any_cast<float>(right);
+    default:
+        return std::any();
+    }
+}
+
+void Interpreter::print(const std::any &val)
+{
+    if (!val.has_value()) {
+        output->write("nil");
+        return;
+    }
+
+    if (val.type() == typeid(float)) {
+        output->write(format_number(std::any_cast<float>(val)));
+    } else if (is_string(val)) {
+        output->write(as_string(val));
+    } else if (val.type() == typeid(bool)) {
+        output->write(std::any_cast<bool>(val) ? "true" : "false");
+    } else if (val.type() == typeid(std::shared_ptr<LoxCallable>)) {
+        output->write(std::any_cast<std::shared_ptr<LoxCallable>>(val)->to_string());
+    } else if (val.type() == typeid(std::shared_ptr<LoxClass>)) {
+        output->write(std::any_cast<std::shared_ptr<LoxClass>>(val)->to_string());
+    } else if (val.type() == typeid(std::shared_ptr<LoxInstance>)) {
+        output->write(std::any_cast<std::shared_ptr<LoxInstance>>(val)->to_string());
+    } else {
+        *errors.stream << "[error]: Unsupported val type!?\n";
+        return;
+    }
+    output->write("\n");
+}
+
+
 void Interpreter::check_type(const std::any &val,
                              const std::vector<std::type_index> &valid_types,
                              const Token &t)
 {
+    const auto ty = type_of(val);
     for (const auto &t : valid_types) {
-        if (std::type_index(val.type()) == t) {
+        if (ty == t) {
             return;
         }
     }
@@ -370,14 +479,34 @@ void Interpreter::check_type(const std::any &val,
     throw InterpreterError(t, error_msg);
 }
 
+std::shared_ptr<JitCode> Interpreter::compile_loop(const While &w)
+{
+    auto &loop = loops[&w];
+    if (!loop.code || (loop.code->speculative && loop.code->deopts > jit.deopt_limit)) {
+        const bool speculate = jit.speculate && !(loop.code && loop.code->speculative);
+        loop.program = program->shared_from_this();
+        loop.code = jit_compile_loop(w, *program, speculate ? feedback : nullptr);
+    }
+    return loop.code;
+}
+
 void Interpreter::check_same_type(const std::any &a, const std::any &b, const Token &t) const
 {
-    if (a.type() != b.type()) {
+    if (type_of(a) != type_of(b)) {
         throw InterpreterError(
             t, "Expected " + pretty_type_name(a) + " but got " + pretty_type_name(b));
     }
 }
 
+std::type_index Interpreter::type_of(const std::any &val) const
+{
+    const auto ty = std::type_index(val.type());
+    if (ty == rope_id) {
+        return string_id;
+    }
+    return ty;
+}
+
 bool Interpreter::is_true(const std::any &x) const
 {
     const auto ty = std::type_index(x.type());
@@ -397,11 +526,11 @@ bool Interpreter::is_true(const std::any &x) const
 bool Interpreter::is_equal(const std::any &a, const std::any &b) const
 {
     // Comparing objects of different types is always false
-    if (a.type() != b.type()) {
+    const auto a_ty = type_of(a);
+    if (a_ty != type_of(b)) {
         return false;
     }
 
-    const auto a_ty = std::type_index(a.type());
     if (a_ty == nil_id) {
         return true;
     }
@@ -409,17 +538,17 @@ bool Interpreter::is_equal(const std::any &a, const std::any &b) const
         return std::any_cast<float>(a) == std::any_cast<float>(b);
     }
     if (a_ty == string_id) {
-        return std::any_cast<std::string>(a) == std::any_cast<std::string>(b);
+        return as_string(a) == as_string(b);
     }
     return std::any_cast<bool>(a) == std::any_cast<bool>(b);
 }
 
 std::any Interpreter::lookup_variable(const Token &token, const Expr &expr) const
 {
-    auto fnd = locals.find(&expr);
-    if (fnd != locals.end()) {
-        return environment->get_at(fnd->second, token.lexeme);
+    auto fnd = program->locals.find(&expr);
+    if (fnd != program->locals.end()) {
+        return environment->get_at(fnd->second, token.symbol);
     } else {
-        return globals->get(token.lexeme);
+        return globals->get(token.symbol);
     }
 }
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <deque>
 #include <typeindex>
 #include <typeinfo>
 #include <unordered_map>
 #include <vector>
 #include "environment.h"
+#include "error_reporter.h"
 #include "expr.h"
+#include "jit.h"
+#include "output_sink.h"
+#include "program.h"
+
+struct LoxCallable;
+struct TypeFeedback;
 
 struct InterpreterError {
     Token token;
@@ -24,28 +32,113 @@ struct ReturnControlFlow {
     ReturnControlFlow() = default;
 };
 
+// Switches the interpreter to look up variables in the program, restoring the
+// previous one when the scope exits
+struct ProgramScope {
+    const Program *&current;
+    const Program *prev;
+
+    ProgramScope(const Program *&current, const Program *program);
+
+    ~ProgramScope();
+
+    ProgramScope(const ProgramScope &s) = delete;
+    ProgramScope &operator=(const ProgramScope &s) = delete;
+};
+
+// Records type feedback into a function's profile while it runs, restoring the
+// previous profile when the scope exits
+struct FeedbackScope {
+    TypeFeedback *&current;
+    TypeFeedback *prev;
+
+    FeedbackScope(TypeFeedback *&current, TypeFeedback *feedback);
+
+    ~FeedbackScope();
+
+    FeedbackScope(const FeedbackScope &s) = delete;
+    FeedbackScope &operator=(const FeedbackScope &s) = delete;
+};
+
+// Claims the argument list for a call at the current depth of the call stack,
+// releasing it when the call returns or throws
+struct CallFrame {
+    std::vector<std::any> &args;
+    size_t &depth;
+
+    CallFrame(std::vector<std::any> &args, size_t &depth);
+
+    ~CallFrame();
+
+    CallFrame(const CallFrame &f) = delete;
+    CallFrame &operator=(const CallFrame &f) = delete;
+};
+
 struct Interpreter : Expr::Visitor, Stmt::Visitor {
     std::shared_ptr<Environment> globals = std::make_shared<Environment>();
     std::shared_ptr<Environment> environment = globals;
-    // Track the depth each variable expresion is resolved to
-    // So couldn't this just be "Variable*"?
-    // NOTE: The pointers all refer to objects held in std::shared_ptr, though
-    // with how the visitor pattern works here the shared ptr is not directly
-    // accessible since visit is called by the object itself.
-    // Maybe clox introduces a better design here, or just uses raw pointers throughout?
-    std::unordered_map<const Expr *, size_t> locals;
+    // The program currently being run, whose resolved locals are used to look up
+    // variables. Functions switch to the program they were declared in when
+    // called, and keep it alive, so this doesn't need to own it
+    const Program *program = nullptr;
     std::any result;
-
+    // Where print statements write to
+    std::shared_ptr<OutputSink> output;
+    ErrorReporter errors;
+    // When the functions called by this interpreter are compiled to native code
+    JitOptions jit;
+    // Where the types seen by binary and call expressions are recorded, set
+    // while running a function that will be compiled by the JIT
+    TypeFeedback *feedback = nullptr;
+
+    // Create an interpreter printing to a buffered sink on stdout, and reporting
+    // errors to std::cerr
     Interpreter();
 
-    void evaluate(const std::vector<std::shared_ptr<Stmt>> &statements);
+    Interpreter(const std::shared_ptr<OutputSink> &output);
+
+    Interpreter(const std::shared_ptr<OutputSink> &output, const ErrorReporter &errors);
+
+    // Run the program, which can be shared with other interpreters. Returns false
+    // if a runtime error stopped its top-level statements, errors in nested blocks
+    // are reported where they're caught and don't stop them
+    bool evaluate(const std::shared_ptr<const Program> &program);
+
+    bool evaluate(const std::vector<std::shared_ptr<Stmt>> &statements);
 
     const std::any &evaluate(const Expr &expr);
 
     void execute_block(const std::vector<std::shared_ptr<Stmt>> &statements,
                        std::shared_ptr<Environment> &env);
 
-    void resolve(const Expr &expr, size_t depth);
+    // Define a global native function calling fn. The arity and argument
+    // conversions are derived from its signature, see native.h
+    template <typename Fn>
+    void register_native(const std::string &name, Fn fn);
+
+    // The operations shared by the visitors and the code compiled by the JIT,
+    // which evaluates the operands itself, see jit.h
+
+    // Claim the argument list for a call at the current depth of the call stack
+    CallFrame enter_call();
+
+    // Call the function or class with the arguments, throws an InterpreterError
+    // if it isn't callable or the arity doesn't match
+    std::any call(const std::any &callee, std::vector<std::any> &args, const Token &paren);
+
+    // Call the callable, whose arity has been checked. Natives throw errors
+    // without a token, those are reported at the call
+    std::any invoke(LoxCallable &fcn, std::vector<std::any> &args, const Token &paren);
+
+    std::any unary(const Token &op, const std::any &right);
+
+    // Apply the operator, the operands may be converted in place when a number
+    // is concatenated to a string
+    std::any binary(const Token &op, std::any &left, std::any &right);
+
+    void print(const std::any &val);
+
+    bool is_true(const std::any &x) const;
 
     void visit(const Grouping &g) override;
     void visit(const Literal &l) override;
@@ -69,7 +162,20 @@ struct Interpreter : Expr::Visitor, Stmt::Visitor {
     void visit(const Class &c) override;
 
 private:
-    std::type_index float_id, string_id, bool_id, nil_id, callable_id;
+    // Argument lists for each depth of the call stack, which are reused so
+    // calls don't allocate a new vector each time
+    std::deque<std::vector<std::any>> call_args;
+    size_t call_depth = 0;
+
+    // Loops which got hot and were compiled, along with the program they're
+    // declared in so it's kept alive
+    struct CompiledLoop {
+        std::shared_ptr<const Program> program;
+        std::shared_ptr<JitCode> code;
+    };
+    std::unordered_map<const While *, CompiledLoop> loops;
+
+    std::type_index float_id, string_id, rope_id, bool_id, nil_id, callable_id;
     std::unordered_map<std::type_index, std::string> type_names;
 
     // Check if the type is one of the specified valid types, if not throws an
@@ -78,10 +184,16 @@ private:
                     const std::vector<std::type_index> &valid_types,
                     const Token &t);
 
+    // The compiled code for the loop, compiled the first time it's needed or
+    // again without speculation once that's failed too often. Returns nullptr
+    // if it can't be compiled
+    std::shared_ptr<JitCode> compile_loop(const While &w);
+
     // Check if the two anys have the same type, if not throws an InterpreterError
     void check_same_type(const std::any &a, const std::any &b, const Token &t) const;
 
-    bool is_true(const std::any &x) const;
+    // Get the type of the value, with ropes treated as strings
+    std::type_index type_of(const std::any &val) const;
 
     bool is_equal(const std::any &a, const std::any &b) const;
 
@@ -0,0 +1,108 @@
+#include "isolate.h"
+#include <algorithm>
+#include <stdexcept>
+#include "lox.h"
+
+Isolate::Isolate() {}
+
+Isolate::Isolate(const std::shared_ptr<OutputSink> &output, std::ostream &error_stream)
+    : interpreter(output, ErrorReporter(error_stream))
+{
+}
+
+bool Isolate::run(std::string_view source)
+{
+    const bool ok = run_script(source, interpreter);
+    interpreter.output->flush();
+    return ok;
+}
+
+bool Isolate::run(const std::shared_ptr<const Program> &program)
+{
+    const bool ok = run_program(program, interpreter);
+    interpreter.output->flush();
+    return ok;
+}
+
+IsolatePool::IsolatePool(size_t num_threads)
+{
+    // hardware_concurrency can return 0 if it's unknown
+    num_threads = std::max(num_threads, size_t(1));
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers.emplace_back([this]() { worker(); });
+    }
+}
+
+IsolatePool::~IsolatePool()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    for (auto &w : workers) {
+        w.join();
+    }
+}
+
+std::future<bool> IsolatePool::submit(const std::shared_ptr<Isolate> &isolate,
+                                      const std::string &source)
+{
+    return submit(
+        std::packaged_task<bool()>([isolate, source]() { return isolate->run(source); }));
+}
+
+std::future<bool> IsolatePool::submit(const std::shared_ptr<Isolate> &isolate,
+                                      const std::shared_ptr<const Program> &program)
+{
+    return submit(
+        std::packaged_task<bool()>([isolate, program]() { return isolate->run(program); }));
+}
+
+std::future<bool> IsolatePool::submit(std::packaged_task<bool()> task)
+{
+    auto result = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.push_back(std::move(task));
+    }
+    queue_cv.notify_one();
+    return result;
+}
+
+void IsolatePool::worker()
+{
+    while (true) {
+        std::packaged_task<bool()> task;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+    }
+}
+
+std::vector<bool> run_isolates(IsolatePool &pool,
+                               const std::vector<std::shared_ptr<Isolate>> &isolates,
+                               const std::vector<std::string> &sources)
+{
+    if (isolates.size() != sources.size()) {
+        throw std::runtime_error("run_isolates requires one source per isolate");
+    }
+
+    std::vector<std::future<bool>> pending;
+    for (size_t i = 0; i < isolates.size(); ++i) {
+        pending.push_back(pool.submit(isolates[i], sources[i]));
+    }
+
+    std::vector<bool> results;
+    for (auto &p : pending) {
+        results.push_back(p.get());
+    }
+    return results;
+}
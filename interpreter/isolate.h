@@ -0,0 +1,72 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "interpreter.h"
+#include "output_sink.h"
+#include "program.h"
+
+// An independent instance of the interpreter, with its own globals, error
+// reporting and output sink. Isolates don't share any mutable state, so separate
+// isolates can run scripts on different threads at the same time.
+struct Isolate {
+    Interpreter interpreter;
+
+    // Print to a buffered sink on stdout and report errors to std::cerr
+    Isolate();
+
+    Isolate(const std::shared_ptr<OutputSink> &output, std::ostream &error_stream);
+
+    Isolate(const Isolate &i) = delete;
+    Isolate &operator=(const Isolate &i) = delete;
+
+    // Compile and run the script, returns false if there were errors
+    bool run(std::string_view source);
+
+    // Run the already compiled program, returns false if there were runtime errors
+    bool run(const std::shared_ptr<const Program> &program);
+};
+
+// Runs scripts in isolates on a fixed pool of worker threads
+class IsolatePool {
+    std::vector<std::thread> workers;
+    std::deque<std::packaged_task<bool()>> queue;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stopping = false;
+
+public:
+    IsolatePool(size_t num_threads = std::thread::hardware_concurrency());
+
+    // Finishes running any queued scripts before returning
+    ~IsolatePool();
+
+    IsolatePool(const IsolatePool &p) = delete;
+    IsolatePool &operator=(const IsolatePool &p) = delete;
+
+    // Queue the script to run in the isolate, the future is set with the result of
+    // Isolate::run. An isolate must only have one script queued or running at a time.
+    std::future<bool> submit(const std::shared_ptr<Isolate> &isolate, const std::string &source);
+
+    std::future<bool> submit(const std::shared_ptr<Isolate> &isolate,
+                             const std::shared_ptr<const Program> &program);
+
+private:
+    std::future<bool> submit(std::packaged_task<bool()> task);
+
+    void worker();
+};
+
+// Run each script in the corresponding isolate on the pool, and wait for all of
+// them to finish. Returns the result of each isolate's run
+std::vector<bool> run_isolates(IsolatePool &pool,
+                               const std::vector<std::shared_ptr<Isolate>> &isolates,
+                               const std::vector<std::string> &sources);
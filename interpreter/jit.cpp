@@ -0,0 +1,1001 @@
+#include "jit.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include "environment.h"
+#include "interpreter.h"
+#include "lox_callable.h"
+#include "lox_class.h"
+
+#if LOX_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+namespace {
+// What a stub tells the compiled code to do next. After a runtime error the rest
+// of the innermost statement list is skipped and the error reported, the same as
+// Interpreter::evaluate does, while leaving returns from the function
+enum Status : int { CONTINUE = 0, ABORT = 1, LEAVE = 2 };
+
+struct JitFrame {
+    Interpreter &interpreter;
+    std::any *temps;
+    // The unboxed numbers of the specialized code
+    float *floats;
+    // The value returned by the function
+    std::any value;
+    // An exception which isn't a runtime error, rethrown once the compiled code
+    // has returned since it can't unwind through it
+    std::exception_ptr error;
+    // The number of guards which failed
+    size_t deopts;
+    // The runtime error skipping the current statement list, reported at its end
+    std::optional<InterpreterError> pending;
+};
+
+#if LOX_JIT_SUPPORTED
+using Stub = int (*)(JitFrame *, const JitOp *);
+using Entry = int (*)(JitFrame *, float *);
+
+template <typename T>
+const T &node(const JitOp *op)
+{
+    return *static_cast<const T *>(op->node);
+}
+
+// Run fn, catching any exception since they can't unwind through the compiled
+// code. Runtime errors abort the statement list, anything else leaves the
+// function and is rethrown by JitCode::run
+template <typename Fn>
+int guard(JitFrame *frame, Fn fn)
+{
+    try {
+        fn();
+    } catch (const InterpreterError &e) {
+        frame->pending = e;
+        return ABORT;
+    } catch (...) {
+        frame->error = std::current_exception();
+        return LEAVE;
+    }
+    return CONTINUE;
+}
+
+int literal(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] { frame->temps[op->slot] = node<Literal>(op).value; });
+}
+
+int variable(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] {
+        const auto &v = node<Variable>(op);
+        auto &interpreter = frame->interpreter;
+        try {
+            frame->temps[op->slot] =
+                op->depth == JitOp::GLOBAL
+                    ? interpreter.globals->get(v.name.symbol)
+                    : interpreter.environment->get_at(op->depth, v.name.symbol);
+        } catch (const std::runtime_error &) {
+            throw InterpreterError(v.name, "Undefined variable");
+        }
+    });
+}
+
+int assign(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] {
+        const auto &a = node<Assign>(op);
+        auto &interpreter = frame->interpreter;
+        try {
+            if (op->depth == JitOp::GLOBAL) {
+                interpreter.globals->assign(a.name.symbol, frame->temps[op->slot]);
+            } else {
+                interpreter.environment->assign_at(
+                    op->depth, a.name.symbol, frame->temps[op->slot]);
+            }
+        } catch (const std::runtime_error &) {
+            throw InterpreterError(a.name, "Undefined variable");
+        }
+    });
+}
+
+int unary(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] {
+        auto &operand = frame->temps[op->slot];
+        operand = frame->interpreter.unary(node<Unary>(op).op, operand);
+    });
+}
+
+int binary(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] {
+        auto *operands = frame->temps + op->slot;
+        operands[0] = frame->interpreter.binary(node<Binary>(op).op, operands[0], operands[1]);
+    });
+}
+
+int call(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] {
+        const auto &c = node<Call>(op);
+        auto &interpreter = frame->interpreter;
+        auto *operands = frame->temps + op->slot;
+        CallFrame call_frame = interpreter.enter_call();
+        for (size_t i = 1; i <= c.args.size(); ++i) {
+            call_frame.args.push_back(std::move(operands[i]));
+        }
+        if (op->target) {
+            // The callee is checked against the function seen by the call without
+            // copying it out of the temporary, and the arity still has to be
+            // checked in case a different function was allocated at its address
+            const auto *fcn = std::any_cast<std::shared_ptr<LoxCallable>>(&operands[0]);
+            if (fcn && fcn->get() == op->target && (*fcn)->arity() == c.args.size()) {
+                operands[0] = interpreter.invoke(**fcn, call_frame.args, c.paren);
+                return;
+            }
+            ++frame->deopts;
+        }
+        operands[0] = interpreter.call(operands[0], call_frame.args, c.paren);
+    });
+}
+
+int get_property(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] {
+        // Anything but an instance is left as the result, like Interpreter::visit
+        auto &object = frame->temps[op->slot];
+        if (const auto *inst = std::any_cast<std::shared_ptr<LoxInstance>>(&object)) {
+            object = (*inst)->get(node<Get>(op).name);
+        }
+    });
+}
+
+// Returns 1 if the temporary is true and 0 if it isn't, this can't fail
+int truthy(JitFrame *frame, const JitOp *op)
+{
+    return frame->interpreter.is_true(frame->temps[op->slot]);
+}
+
+int evaluate(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] {
+        frame->temps[op->slot] = frame->interpreter.evaluate(node<Expr>(op));
+    });
+}
+
+int execute(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] { node<Stmt>(op).accept(frame->interpreter); });
+}
+
+int print(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] { frame->interpreter.print(frame->temps[op->slot]); });
+}
+
+int define(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] {
+        const auto &v = node<Var>(op);
+        std::any initializer;
+        if (v.initializer) {
+            initializer = std::move(frame->temps[op->slot]);
+        }
+        frame->interpreter.environment->define(v.token.symbol, initializer);
+    });
+}
+
+// Enter a block's scope, saving the enclosing environment in the temporary
+int enter_scope(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] {
+        auto &interpreter = frame->interpreter;
+        frame->temps[op->slot] = interpreter.environment;
+        interpreter.environment = std::make_shared<Environment>(interpreter.environment);
+    });
+}
+
+int exit_scope(JitFrame *frame, const JitOp *op)
+{
+    frame->interpreter.environment =
+        std::any_cast<std::shared_ptr<Environment>>(std::move(frame->temps[op->slot]));
+    return CONTINUE;
+}
+
+// Load a variable into an unboxed float, returns 1 if it isn't a number
+int load_float(JitFrame *frame, const JitOp *op)
+{
+    const auto &v = node<Variable>(op);
+    auto &interpreter = frame->interpreter;
+    const std::any *value = op->depth == JitOp::GLOBAL
+                                ? interpreter.globals->find(v.name.symbol)
+                                : interpreter.environment->find_at(op->depth, v.name.symbol);
+    const float *f = value ? std::any_cast<float>(value) : nullptr;
+    if (!f) {
+        return 1;
+    }
+    frame->floats[op->slot] = *f;
+    return 0;
+}
+
+// Box the result of specialized arithmetic, which is in the first float
+int box_float(JitFrame *frame, const JitOp *op)
+{
+    return guard(frame, [&] { frame->temps[op->slot] = frame->floats[0]; });
+}
+
+int deoptimize(JitFrame *frame, const JitOp *)
+{
+    ++frame->deopts;
+    return CONTINUE;
+}
+
+int report(JitFrame *frame, const JitOp *)
+{
+    frame->interpreter.errors.error(frame->pending->token, frame->pending->message);
+    frame->pending.reset();
+    return CONTINUE;
+}
+
+int return_value(JitFrame *frame, const JitOp *op)
+{
+    if (node<Return>(op).value) {
+        frame->value = std::move(frame->temps[op->slot]);
+    }
+    return LEAVE;
+}
+
+// Emits the few x86-64 instructions the compiled code is made of. The frame is
+// kept in rbx and the unboxed floats in r12, which are callee saved, for the stub
+// calls. The floats are only held in xmm registers within an operation, since
+// the stub calls don't preserve them
+class Assembler {
+public:
+    using Label = size_t;
+
+    enum Condition : uint8_t {
+        ALWAYS = 0,
+        BELOW = 0x82,
+        EQUAL = 0x84,
+        NOT_EQUAL = 0x85,
+        BELOW_EQUAL = 0x86,
+        ABOVE = 0x87
+    };
+
+    // The SSE arithmetic instructions on scalar floats
+    enum FloatOp : uint8_t { ADD = 0x58, MUL = 0x59, SUB = 0x5c, DIV = 0x5e };
+
+    std::vector<uint8_t> code;
+
+    Label label()
+    {
+        labels.push_back(UNBOUND);
+        return labels.size() - 1;
+    }
+
+    void bind(Label l)
+    {
+        labels[l] = code.size();
+    }
+
+    void prologue()
+    {
+        // push rbx; push r12; sub rsp, 8 to keep the stack aligned for calls;
+        // mov rbx, rdi; mov r12, rsi
+        emit({0x53, 0x41, 0x54, 0x48, 0x83, 0xec, 0x08, 0x48, 0x89, 0xfb, 0x49, 0x89, 0xf4});
+    }
+
+    void epilogue()
+    {
+        // add rsp, 8; pop r12; pop rbx; ret
+        emit({0x48, 0x83, 0xc4, 0x08, 0x41, 0x5c, 0x5b, 0xc3});
+    }
+
+    void clear_result()
+    {
+        // xor eax, eax
+        emit({0x31, 0xc0});
+    }
+
+    void call(Stub stub, const JitOp *op)
+    {
+        // mov rdi, rbx; mov rsi, op; mov rax, stub; call rax
+        emit({0x48, 0x89, 0xdf, 0x48, 0xbe});
+        emit_u64(reinterpret_cast<uint64_t>(op));
+        emit({0x48, 0xb8});
+        emit_u64(reinterpret_cast<uint64_t>(stub));
+        emit({0xff, 0xd0});
+    }
+
+    // Compare the status returned by a stub to ABORT
+    void check_status()
+    {
+        // cmp eax, ABORT
+        emit({0x83, 0xf8, ABORT});
+    }
+
+    // Test the condition returned by the truthy stub
+    void test_result()
+    {
+        // test eax, eax
+        emit({0x85, 0xc0});
+    }
+
+    // Set the float to the constant
+    void store_constant(size_t f, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        // mov dword [r12 + 4 * f], bits
+        emit({0x41, 0xc7});
+        float_address(0, f);
+        emit_u32(bits);
+    }
+
+    void load_float(uint8_t xmm, size_t f)
+    {
+        // movss xmm, [r12 + 4 * f]
+        emit({0xf3, 0x41, 0x0f, 0x10});
+        float_address(xmm, f);
+    }
+
+    void store_float(size_t f, uint8_t xmm)
+    {
+        // movss [r12 + 4 * f], xmm
+        emit({0xf3, 0x41, 0x0f, 0x11});
+        float_address(xmm, f);
+    }
+
+    // Apply the operation to the register and the float
+    void float_op(FloatOp op, uint8_t xmm, size_t f)
+    {
+        // op xmm, [r12 + 4 * f]
+        emit({0xf3, 0x41, 0x0f, op});
+        float_address(xmm, f);
+    }
+
+    // Apply the operation to the two registers
+    void float_register_op(FloatOp op, uint8_t dst, uint8_t src)
+    {
+        // op dst, src
+        emit({0xf3, 0x0f, op, register_operands(dst, src)});
+    }
+
+    void negate_float(size_t f)
+    {
+        // xor dword [r12 + 4 * f], sign bit
+        emit({0x41, 0x81});
+        float_address(6, f);
+        emit_u32(0x80000000);
+    }
+
+    void zero(uint8_t xmm)
+    {
+        // xorps xmm, xmm
+        emit({0x0f, 0x57, register_operands(xmm, xmm)});
+    }
+
+    // Set the flags as an unsigned comparison of a to b, or as below if either
+    // is NaN
+    void compare_floats(uint8_t a, uint8_t b)
+    {
+        // ucomiss a, b
+        emit({0x0f, 0x2e, register_operands(a, b)});
+    }
+
+    void jump(Condition cond, Label target)
+    {
+        if (cond == ALWAYS) {
+            emit({0xe9});
+        } else {
+            emit({0x0f, cond});
+        }
+        fixups.emplace_back(code.size(), target);
+        emit({0, 0, 0, 0});
+    }
+
+    // Resolve the jumps to their labels
+    void finish()
+    {
+        for (const auto &f : fixups) {
+            const int32_t rel = static_cast<int32_t>(labels[f.second] - (f.first + 4));
+            std::memcpy(&code[f.first], &rel, sizeof(rel));
+        }
+        fixups.clear();
+    }
+
+private:
+    static constexpr size_t UNBOUND = SIZE_MAX;
+
+    std::vector<size_t> labels;
+    // The offsets of the rel32 operands to patch with their labels
+    std::vector<std::pair<size_t, Label>> fixups;
+
+    void emit(std::initializer_list<uint8_t> bytes)
+    {
+        code.insert(code.end(), bytes);
+    }
+
+    // The ModRM, SIB and displacement addressing [r12 + 4 * f], with reg in the
+    // register field
+    void float_address(uint8_t reg, size_t f)
+    {
+        emit({static_cast<uint8_t>(0x84 | (reg << 3)), 0x24});
+        emit_u32(static_cast<uint32_t>(4 * f));
+    }
+
+    static uint8_t register_operands(uint8_t reg, uint8_t rm)
+    {
+        return static_cast<uint8_t>(0xc0 | (reg << 3) | rm);
+    }
+
+    void emit_u32(uint32_t v)
+    {
+        uint8_t bytes[sizeof(v)];
+        std::memcpy(bytes, &v, sizeof(v));
+        code.insert(code.end(), bytes, bytes + sizeof(v));
+    }
+
+    void emit_u64(uint64_t v)
+    {
+        uint8_t bytes[sizeof(v)];
+        std::memcpy(bytes, &v, sizeof(v));
+        code.insert(code.end(), bytes, bytes + sizeof(v));
+    }
+};
+
+// Translates the body to stub calls. Expressions are evaluated into the
+// temporary at slot, with their operands in the temporaries following it. With
+// type feedback, arithmetic on numbers is evaluated into the unboxed floats,
+// starting from the first float at the root of the arithmetic
+class Compiler : Expr::Visitor, Stmt::Visitor {
+public:
+    Compiler(JitCode &jit, const Program &program, const TypeFeedback *feedback)
+        : jit(jit), program(program), feedback(feedback)
+    {
+    }
+
+    void compile(const Stmt &body)
+    {
+        exit = as.label();
+        as.prologue();
+        statement_list({&body});
+        as.clear_result();
+        as.bind(exit);
+        as.epilogue();
+        as.finish();
+    }
+
+    // A loop entered from the interpreter runs in the statement list the
+    // interpreter is running it in, so a runtime error in its condition is left
+    // pending for JitCode::run to rethrow
+    void compile_loop(const While &w)
+    {
+        exit = as.label();
+        as.prologue();
+        abort = as.label();
+        w.accept(*this);
+        as.bind(abort);
+        as.clear_result();
+        as.bind(exit);
+        as.epilogue();
+        as.finish();
+    }
+
+    const std::vector<uint8_t> &code() const
+    {
+        return as.code;
+    }
+
+    void visit(const Grouping &g) override
+    {
+        expr(*g.expr, slot);
+    }
+
+    void visit(const Literal &l) override
+    {
+        emit(literal, &l);
+    }
+
+    void visit(const Unary &u) override
+    {
+        expr(*u.expr, slot);
+        emit(unary, &u);
+    }
+
+    void visit(const Binary &b) override
+    {
+        if (!floatable(b)) {
+            generic_binary(b);
+            return;
+        }
+
+        auto generic = as.label();
+        auto end = as.label();
+        float_expr(b, 0, generic);
+        emit(box_float, &b);
+        as.jump(Assembler::ALWAYS, end);
+        as.bind(generic);
+        as.call(deoptimize, op(&b));
+        generic_binary(b);
+        as.bind(end);
+    }
+
+    void visit(const Call &c) override
+    {
+        expr(*c.callee, slot);
+        for (size_t i = 0; i < c.args.size(); ++i) {
+            expr(*c.args[i], slot + 1 + i);
+        }
+        const auto *call_op = op(&c);
+        if (feedback) {
+            jit.ops.back().target = feedback->target(c);
+        }
+        check(call, call_op);
+    }
+
+    void visit(const Logical &l) override
+    {
+        // The left operand is the result if it short circuits
+        auto end = as.label();
+        expr(*l.left, slot);
+        as.call(truthy, op(&l));
+        as.test_result();
+        as.jump(l.op.type == TokenType::OR ? Assembler::NOT_EQUAL : Assembler::EQUAL, end);
+        expr(*l.right, slot);
+        as.bind(end);
+    }
+
+    void visit(const Variable &v) override
+    {
+        emit(variable, &v, scope_depth(v));
+    }
+
+    void visit(const Assign &a) override
+    {
+        expr(*a.value, slot);
+        emit(assign, &a, scope_depth(a));
+    }
+
+    void visit(const Get &g) override
+    {
+        expr(*g.object, slot);
+        emit(get_property, &g);
+    }
+
+    void visit(const Set &s) override
+    {
+        emit(evaluate, static_cast<const Expr *>(&s));
+    }
+
+    void visit(const Block &b) override
+    {
+        // The enclosing environment is saved in this statement's temporary
+        const auto *scope = op(&b);
+        as.call(enter_scope, scope);
+        ++slot;
+        reserve(slot);
+        std::vector<const Stmt *> statements;
+        for (const auto &s : b.statements) {
+            statements.push_back(s.get());
+        }
+        statement_list(statements);
+        --slot;
+        as.call(exit_scope, scope);
+    }
+
+    void visit(const Expression &e) override
+    {
+        expr(*e.expr, slot);
+    }
+
+    void visit(const If &f) override
+    {
+        auto otherwise = as.label();
+        auto end = as.label();
+        condition(*f.condition, otherwise);
+        statement_list({f.then_branch.get()});
+        as.jump(Assembler::ALWAYS, end);
+        as.bind(otherwise);
+        if (f.else_branch) {
+            statement_list({f.else_branch.get()});
+        }
+        as.bind(end);
+    }
+
+    void visit(const While &w) override
+    {
+        auto top = as.label();
+        auto end = as.label();
+        as.bind(top);
+        condition(*w.condition, end);
+        statement_list({w.body.get()});
+        as.jump(Assembler::ALWAYS, top);
+        as.bind(end);
+    }
+
+    void visit(const Print &p) override
+    {
+        expr(*p.expr, slot);
+        emit(print, &p);
+    }
+
+    void visit(const Var &v) override
+    {
+        if (v.initializer) {
+            expr(*v.initializer, slot);
+        }
+        emit(define, &v);
+    }
+
+    void visit(const Function &f) override
+    {
+        emit(execute, static_cast<const Stmt *>(&f));
+    }
+
+    void visit(const Return &r) override
+    {
+        if (r.value) {
+            expr(*r.value, slot);
+        }
+        emit(return_value, &r);
+    }
+
+    void visit(const Class &c) override
+    {
+        emit(execute, static_cast<const Stmt *>(&c));
+    }
+
+private:
+    JitCode &jit;
+    const Program &program;
+    const TypeFeedback *feedback;
+    Assembler as;
+    uint32_t slot = 0;
+    // Where a runtime error jumps to, the end of the innermost statement list
+    Assembler::Label abort = 0;
+    Assembler::Label exit = 0;
+
+    void reserve(size_t s)
+    {
+        jit.temps = std::max(jit.temps, s + 1);
+    }
+
+    void reserve_floats(size_t f)
+    {
+        jit.floats = std::max(jit.floats, f + 1);
+    }
+
+    const JitOp *op(const void *node, size_t depth = JitOp::GLOBAL)
+    {
+        reserve(slot);
+        return unboxed_op(node, slot, depth);
+    }
+
+    // An operand whose slot is one of the unboxed floats
+    const JitOp *unboxed_op(const void *node, size_t f, size_t depth = JitOp::GLOBAL)
+    {
+        jit.ops.push_back(JitOp{node, static_cast<uint32_t>(f), depth, nullptr});
+        return &jit.ops.back();
+    }
+
+    size_t scope_depth(const Expr &e) const
+    {
+        auto fnd = program.locals.find(&e);
+        return fnd != program.locals.end() ? fnd->second : JitOp::GLOBAL;
+    }
+
+    // Call the stub, then skip the rest of the statement list if it reported an
+    // error or leave if it returned
+    void emit(Stub stub, const void *node, size_t depth = JitOp::GLOBAL)
+    {
+        check(stub, op(node, depth));
+    }
+
+    void check(Stub stub, const JitOp *op)
+    {
+        as.call(stub, op);
+        as.check_status();
+        as.jump(Assembler::EQUAL, abort);
+        as.jump(Assembler::ABOVE, exit);
+    }
+
+    void generic_binary(const Binary &b)
+    {
+        expr(*b.left, slot);
+        expr(*b.right, slot + 1);
+        emit(binary, &b);
+    }
+
+    static bool arithmetic(TokenType t)
+    {
+        return t == TokenType::PLUS || t == TokenType::MINUS || t == TokenType::STAR ||
+               t == TokenType::SLASH;
+    }
+
+    static bool comparison(TokenType t)
+    {
+        return t == TokenType::LESS || t == TokenType::LESS_EQUAL || t == TokenType::GREATER ||
+               t == TokenType::GREATER_EQUAL;
+    }
+
+    // Whether the expression is arithmetic which has only seen numbers, on
+    // operands which are either more of it, numeric literals or variables
+    bool floatable(const Expr &e) const
+    {
+        if (!feedback) {
+            return false;
+        }
+        if (const auto *b = dynamic_cast<const Binary *>(&e)) {
+            return arithmetic(b->op.type) && feedback->only_floats(*b) && float_operand(*b->left) &&
+                   float_operand(*b->right);
+        }
+        if (const auto *g = dynamic_cast<const Grouping *>(&e)) {
+            return floatable(*g->expr);
+        }
+        if (const auto *u = dynamic_cast<const Unary *>(&e)) {
+            return u->op.type == TokenType::MINUS && floatable(*u->expr);
+        }
+        return false;
+    }
+
+    bool float_operand(const Expr &e) const
+    {
+        if (const auto *l = dynamic_cast<const Literal *>(&e)) {
+            return l->value.type() == typeid(float);
+        }
+        if (const auto *g = dynamic_cast<const Grouping *>(&e)) {
+            return float_operand(*g->expr);
+        }
+        if (const auto *u = dynamic_cast<const Unary *>(&e)) {
+            return u->op.type == TokenType::MINUS && float_operand(*u->expr);
+        }
+        return dynamic_cast<const Variable *>(&e) || floatable(e);
+    }
+
+    // Evaluate the arithmetic into the float f, jumping to generic if a variable
+    // isn't a number or a divisor is 0, which the generic code reports
+    void float_expr(const Expr &e, size_t f, Assembler::Label generic)
+    {
+        reserve_floats(f);
+        if (const auto *l = dynamic_cast<const Literal *>(&e)) {
+            as.store_constant(f, std::any_cast<float>(l->value));
+        } else if (const auto *v = dynamic_cast<const Variable *>(&e)) {
+            as.call(load_float, unboxed_op(v, f, scope_depth(*v)));
+            as.test_result();
+            as.jump(Assembler::NOT_EQUAL, generic);
+        } else if (const auto *g = dynamic_cast<const Grouping *>(&e)) {
+            float_expr(*g->expr, f, generic);
+        } else if (const auto *u = dynamic_cast<const Unary *>(&e)) {
+            float_expr(*u->expr, f, generic);
+            as.negate_float(f);
+        } else if (const auto *b = dynamic_cast<const Binary *>(&e)) {
+            float_expr(*b->left, f, generic);
+            float_expr(*b->right, f + 1, generic);
+            as.load_float(0, f);
+            switch (b->op.type) {
+            case TokenType::PLUS:
+                as.float_op(Assembler::ADD, 0, f + 1);
+                break;
+            case TokenType::MINUS:
+                as.float_op(Assembler::SUB, 0, f + 1);
+                break;
+            case TokenType::STAR:
+                as.float_op(Assembler::MUL, 0, f + 1);
+                break;
+            default:
+                // Equal also covers NaN, which the generic code divides by
+                as.load_float(1, f + 1);
+                as.zero(2);
+                as.compare_floats(1, 2);
+                as.jump(Assembler::EQUAL, generic);
+                as.float_register_op(Assembler::DIV, 0, 1);
+                break;
+            }
+            as.store_float(f, 0);
+        }
+    }
+
+    // Compare two numbers in a condition and jump to otherwise if the
+    // comparison is false, returns false if it isn't speculated on
+    bool float_condition(const Expr &e, Assembler::Label otherwise)
+    {
+        const auto *b = dynamic_cast<const Binary *>(&e);
+        if (!feedback || !b || !comparison(b->op.type) || !feedback->only_floats(*b) ||
+            !float_operand(*b->left) || !float_operand(*b->right)) {
+            return false;
+        }
+
+        auto generic = as.label();
+        auto end = as.label();
+        float_expr(*b->left, 0, generic);
+        float_expr(*b->right, 1, generic);
+        as.load_float(0, 0);
+        as.load_float(1, 1);
+        // Compare so that NaN is false, as it sets the flags to below
+        switch (b->op.type) {
+        case TokenType::LESS:
+            as.compare_floats(1, 0);
+            as.jump(Assembler::BELOW_EQUAL, otherwise);
+            break;
+        case TokenType::LESS_EQUAL:
+            as.compare_floats(1, 0);
+            as.jump(Assembler::BELOW, otherwise);
+            break;
+        case TokenType::GREATER:
+            as.compare_floats(0, 1);
+            as.jump(Assembler::BELOW_EQUAL, otherwise);
+            break;
+        default:
+            as.compare_floats(0, 1);
+            as.jump(Assembler::BELOW, otherwise);
+            break;
+        }
+        as.jump(Assembler::ALWAYS, end);
+
+        as.bind(generic);
+        as.call(deoptimize, op(b));
+        generic_condition(e, otherwise);
+        as.bind(end);
+        return true;
+    }
+
+    void expr(const Expr &e, size_t s)
+    {
+        const uint32_t prev = slot;
+        slot = s;
+        e.accept(*this);
+        slot = prev;
+    }
+
+    // Evaluate the condition and jump to otherwise if it's false
+    void condition(const Expr &e, Assembler::Label otherwise)
+    {
+        if (!float_condition(e, otherwise)) {
+            generic_condition(e, otherwise);
+        }
+    }
+
+    void generic_condition(const Expr &e, Assembler::Label otherwise)
+    {
+        expr(e, slot);
+        as.call(truthy, op(&e));
+        as.test_result();
+        as.jump(Assembler::EQUAL, otherwise);
+    }
+
+    // The interpreter runs the bodies of blocks, functions, ifs and whiles with
+    // Interpreter::evaluate, which stops running the list at a runtime error
+    void statement_list(const std::vector<const Stmt *> &statements)
+    {
+        const auto prev = abort;
+        abort = as.label();
+        const auto end = as.label();
+        for (const auto *s : statements) {
+            s->accept(*this);
+        }
+        as.jump(Assembler::ALWAYS, end);
+        as.bind(abort);
+        as.call(report, op(nullptr));
+        as.bind(end);
+        abort = prev;
+    }
+};
+#endif
+}
+
+JitCode::~JitCode()
+{
+#if LOX_JIT_SUPPORTED
+    if (code) {
+        munmap(code, code_size);
+    }
+#endif
+}
+
+std::any JitCode::run(Interpreter &interpreter, std::shared_ptr<Environment> &env)
+{
+    // Most functions need only a few temporaries, which are kept on the stack
+    constexpr size_t INLINE_TEMPS = 16;
+    std::any inline_temps[INLINE_TEMPS];
+    std::vector<std::any> heap_temps;
+    std::any *temps = inline_temps;
+    if (this->temps > INLINE_TEMPS) {
+        heap_temps.resize(this->temps);
+        temps = heap_temps.data();
+    }
+    float inline_floats[INLINE_TEMPS];
+    std::vector<float> heap_floats;
+    float *floats = inline_floats;
+    if (this->floats > INLINE_TEMPS) {
+        heap_floats.resize(this->floats);
+        floats = heap_floats.data();
+    }
+
+    JitFrame frame{interpreter, temps, floats, std::any(), nullptr, 0, std::nullopt};
+    auto prev = interpreter.environment;
+    interpreter.environment = env;
+    int status = CONTINUE;
+#if LOX_JIT_SUPPORTED
+    status = reinterpret_cast<Entry>(code)(&frame, floats);
+#endif
+    interpreter.environment = prev;
+    deopts += frame.deopts;
+
+    if (frame.error) {
+        std::rethrow_exception(frame.error);
+    }
+    if (frame.pending) {
+        throw *frame.pending;
+    }
+    if (loop && status == LEAVE) {
+        throw std::make_shared<ReturnControlFlow>(frame.value);
+    }
+    return std::move(frame.value);
+}
+
+#if LOX_JIT_SUPPORTED
+namespace {
+template <typename Compile>
+std::shared_ptr<JitCode> assemble(const Program &program, const TypeFeedback *feedback, Compile compile)
+{
+    auto jit = std::make_shared<JitCode>();
+    jit->speculative = feedback != nullptr;
+    Compiler compiler(*jit, program, feedback);
+    compile(compiler);
+
+    // Write the code then make it executable, it's never writable and executable
+    // at the same time
+    const auto &code = compiler.code();
+    void *mem = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return nullptr;
+    }
+    std::memcpy(mem, code.data(), code.size());
+    if (mprotect(mem, code.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, code.size());
+        return nullptr;
+    }
+    jit->code = mem;
+    jit->code_size = code.size();
+    return jit;
+}
+}
+#endif
+
+std::shared_ptr<JitCode> jit_compile(const Stmt &body,
+                                     const Program &program,
+                                     const TypeFeedback *feedback)
+{
+#if LOX_JIT_SUPPORTED
+    return assemble(program, feedback, [&](Compiler &c) { c.compile(body); });
+#else
+    (void)body;
+    (void)program;
+    (void)feedback;
+    return nullptr;
+#endif
+}
+
+std::shared_ptr<JitCode> jit_compile_loop(const While &loop,
+                                          const Program &program,
+                                          const TypeFeedback *feedback)
+{
+#if LOX_JIT_SUPPORTED
+    auto jit = assemble(program, feedback, [&](Compiler &c) { c.compile_loop(loop); });
+    if (jit) {
+        jit->loop = true;
+    }
+    return jit;
+#else
+    (void)loop;
+    (void)program;
+    (void)feedback;
+    return nullptr;
+#endif
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include "expr.h"
+#include "program.h"
+#include "type_feedback.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define LOX_JIT_SUPPORTED 1
+#else
+#define LOX_JIT_SUPPORTED 0
+#endif
+
+class Environment;
+struct Interpreter;
+
+// When functions are compiled to native code
+struct JitOptions {
+    // The JIT is always off on platforms it doesn't support
+    bool enabled = LOX_JIT_SUPPORTED;
+    // The number of calls after which a function is compiled
+    size_t threshold = 100;
+    // Whether functions are compiled to code specialized for the types they've
+    // seen while interpreted
+    bool speculate = true;
+    // The number of times the speculation in a function can fail before it's
+    // compiled again without speculating
+    size_t deopt_limit = 10;
+    // The number of iterations after which a loop run by the interpreter is
+    // compiled, and its remaining iterations run by the compiled code
+    size_t osr_threshold = 1000;
+};
+
+// The operand of a call from compiled code to one of the JIT's stubs: the node
+// the stub runs, and where in the frame's temporaries it reads and writes values
+struct JitOp {
+    // Variables that weren't resolved to a local are globals
+    static constexpr size_t GLOBAL = SIZE_MAX;
+
+    const void *node = nullptr;
+    // The temporary the stub's result is written to, the operands of an
+    // expression are in the temporaries following it
+    uint32_t slot = 0;
+    // The scope depth of a variable
+    size_t depth = GLOBAL;
+    // The callee the stub speculates it will see, from TypeFeedback
+    const void *target = nullptr;
+};
+
+// A function body compiled to x86-64 machine code by the baseline JIT. Each node
+// of the body is translated to a call to a stub which runs it on the
+// interpreter's values, with the control flow between them as native branches:
+// conditions, loops, returns and abandoning a statement list after a runtime
+// error. This removes the dispatch through the visitors, the temporary statement
+// lists of if and while, and the lookups of variables in the program's locals.
+// Declarations of functions and classes, and setting properties, are run by the
+// interpreter from the compiled code.
+//
+// With type feedback the code is specialized for the types the function saw
+// while it was interpreted. Arithmetic which has only seen numbers is done inline
+// with SSE on unboxed floats, and comparisons of them in conditions branch
+// directly on the result. Calls which have only seen one function check for it
+// before calling it directly. The variables the arithmetic loads are guarded to
+// be numbers, and if a guard fails the code deoptimizes to the generic stubs for
+// the whole expression, which run it the same as the interpreter. Nothing in the
+// expression has had side effects by then, as the specialized code only loads
+// variables and literals.
+//
+// The code only refers to the function's AST and the program it was declared
+// in, so it can be run by any interpreter calling the function.
+//
+// A while loop can also be compiled on its own, for on-stack replacement: when a
+// loop the interpreter is running gets hot, the rest of its iterations are run
+// by compiled code instead. All the variables a Lox program uses live in its
+// environments rather than in the interpreter's native stack, so the compiled
+// loop picks up mid-execution just by running in the loop's environment.
+struct JitCode {
+    // The operands of the stub calls, a deque so they don't move as the code
+    // embedding their addresses is emitted
+    std::deque<JitOp> ops;
+    // The number of temporaries and unboxed floats the code needs in its frame
+    size_t temps = 0;
+    size_t floats = 0;
+    // Whether the code was specialized with type feedback, and the number of
+    // times that's failed
+    bool speculative = false;
+    size_t deopts = 0;
+    // Whether the code is a loop compiled by jit_compile_loop
+    bool loop = false;
+    void *code = nullptr;
+    size_t code_size = 0;
+
+    JitCode() = default;
+
+    ~JitCode();
+
+    JitCode(const JitCode &c) = delete;
+    JitCode &operator=(const JitCode &c) = delete;
+
+    // Run the body with env as the function's environment, returns the value it
+    // returned. Runtime errors are reported the same as by the interpreter. A
+    // loop runs with env as the environment it's in, and its returns and errors
+    // in its condition are thrown the same as from Interpreter::visit
+    std::any run(Interpreter &interpreter, std::shared_ptr<Environment> &env);
+};
+
+// Compile the body of a function declared in program, specialized with the
+// feedback if it's set. Returns nullptr if the JIT isn't supported on this
+// platform or the code couldn't be mapped executable
+std::shared_ptr<JitCode> jit_compile(const Stmt &body,
+                                     const Program &program,
+                                     const TypeFeedback *feedback = nullptr);
+
+// Compile a while loop declared in program to be run from its condition by
+// Interpreter::visit, see JitCode
+std::shared_ptr<JitCode> jit_compile_loop(const While &loop,
+                                          const Program &program,
+                                          const TypeFeedback *feedback = nullptr);
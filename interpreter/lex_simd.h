@@ -0,0 +1,269 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LOX_LEX_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Vectorized scanning of the runs of characters that make up most of a script:
+// whitespace, comments, string contents and identifiers. Each function takes the
+// source and a position in it and returns the position of the first character
+// that isn't part of the run, or the end of the source. Blocks are classified 32
+// bytes at a time with AVX2 when it's enabled at compile time, otherwise 16 at a
+// time with SSE2 on x86, and the scalar versions handle other targets and the
+// tail of the source. The scalar versions are the reference the vectorized ones
+// are tested against, see tests/lex_simd_test.cpp.
+
+inline int lex_count_trailing_zeros(uint32_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return i;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+inline int lex_popcount(uint32_t x)
+{
+#ifdef _MSC_VER
+    return __popcnt(x);
+#else
+    return __builtin_popcount(x);
+#endif
+}
+
+inline bool lex_is_identifier_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+#if defined(__AVX2__)
+// A block of the source, with each comparison giving a bitmask of the matching
+// bytes
+struct LexBlock {
+    static constexpr size_t width = 32;
+    __m256i v;
+
+    explicit LexBlock(const char *p) : v(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)))
+    {
+    }
+
+    uint32_t eq(char c) const
+    {
+        return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+    }
+
+    // The bytes in [lo, hi], which must both be ASCII
+    uint32_t in_range(char lo, char hi) const
+    {
+        const auto above = _mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1));
+        const auto below = _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v);
+        return _mm256_movemask_epi8(_mm256_and_si256(above, below));
+    }
+
+    uint32_t identifier_chars() const
+    {
+        // Setting bit 5 maps upper case letters to lower case
+        const auto lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        const auto above = _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1));
+        const auto below = _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower);
+        const uint32_t letters = _mm256_movemask_epi8(_mm256_and_si256(above, below));
+        return letters | in_range('0', '9') | eq('_');
+    }
+};
+#define LOX_LEX_SIMD
+#elif defined(LOX_LEX_SSE2)
+struct LexBlock {
+    static constexpr size_t width = 16;
+    __m128i v;
+
+    explicit LexBlock(const char *p) : v(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) {}
+
+    uint32_t eq(char c) const
+    {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+    }
+
+    uint32_t in_range(char lo, char hi) const
+    {
+        const auto above = _mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1));
+        const auto below = _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), v);
+        return _mm_movemask_epi8(_mm_and_si128(above, below));
+    }
+
+    uint32_t identifier_chars() const
+    {
+        const auto lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        const auto above = _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1));
+        const auto below = _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lower);
+        const uint32_t letters = _mm_movemask_epi8(_mm_and_si128(above, below));
+        return letters | in_range('0', '9') | eq('_');
+    }
+};
+#define LOX_LEX_SIMD
+#endif
+
+inline size_t lex_skip_whitespace_scalar(std::string_view src, size_t pos, int &line)
+{
+    for (; pos < src.size(); ++pos) {
+        const char c = src[pos];
+        if (c == '\n') {
+            ++line;
+        } else if (c != ' ' && c != '\t' && c != '\r') {
+            break;
+        }
+    }
+    return pos;
+}
+
+inline size_t lex_find_line_end_scalar(std::string_view src, size_t pos)
+{
+    while (pos < src.size() && src[pos] != '\n') {
+        ++pos;
+    }
+    return pos;
+}
+
+inline size_t lex_find_block_comment_end_scalar(std::string_view src, size_t pos, int &line)
+{
+    for (; pos < src.size(); ++pos) {
+        if (src[pos] == '*' && pos + 1 < src.size() && src[pos + 1] == '/') {
+            break;
+        }
+        if (src[pos] == '\n') {
+            ++line;
+        }
+    }
+    return pos;
+}
+
+inline size_t lex_find_string_end_scalar(std::string_view src, size_t pos, int &line)
+{
+    for (; pos < src.size() && src[pos] != '"'; ++pos) {
+        if (src[pos] == '\n') {
+            ++line;
+        }
+    }
+    return pos;
+}
+
+inline size_t lex_skip_identifier_scalar(std::string_view src, size_t pos)
+{
+    while (pos < src.size() && lex_is_identifier_char(src[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+#ifdef LOX_LEX_SIMD
+// Mask of the first n bits of a block
+inline uint32_t lex_prefix_mask(int n)
+{
+    return n >= 32 ? ~uint32_t(0) : (uint32_t(1) << n) - 1;
+}
+#endif
+
+// Skip spaces, tabs, carriage returns and newlines, counting the newlines
+inline size_t lex_skip_whitespace(std::string_view src, size_t pos, int &line)
+{
+#ifdef LOX_LEX_SIMD
+    while (pos + LexBlock::width <= src.size()) {
+        const LexBlock block(src.data() + pos);
+        const uint32_t newlines = block.eq('\n');
+        const uint32_t space = block.eq(' ') | block.eq('\t') | block.eq('\r') | newlines;
+        const uint32_t other = ~space & lex_prefix_mask(LexBlock::width);
+        if (other) {
+            const int n = lex_count_trailing_zeros(other);
+            line += lex_popcount(newlines & lex_prefix_mask(n));
+            return pos + n;
+        }
+        line += lex_popcount(newlines);
+        pos += LexBlock::width;
+    }
+#endif
+    return lex_skip_whitespace_scalar(src, pos, line);
+}
+
+// Find the newline ending a line comment
+inline size_t lex_find_line_end(std::string_view src, size_t pos)
+{
+#ifdef LOX_LEX_SIMD
+    while (pos + LexBlock::width <= src.size()) {
+        const uint32_t newlines = LexBlock(src.data() + pos).eq('\n');
+        if (newlines) {
+            return pos + lex_count_trailing_zeros(newlines);
+        }
+        pos += LexBlock::width;
+    }
+#endif
+    return lex_find_line_end_scalar(src, pos);
+}
+
+// Find the "*/" closing a block comment, counting the newlines inside it
+inline size_t lex_find_block_comment_end(std::string_view src, size_t pos, int &line)
+{
+#ifdef LOX_LEX_SIMD
+    while (pos + LexBlock::width <= src.size()) {
+        const LexBlock block(src.data() + pos);
+        const uint32_t newlines = block.eq('\n');
+        uint32_t stars = block.eq('*');
+        while (stars) {
+            const int n = lex_count_trailing_zeros(stars);
+            if (pos + n + 1 < src.size() && src[pos + n + 1] == '/') {
+                line += lex_popcount(newlines & lex_prefix_mask(n));
+                return pos + n;
+            }
+            stars &= stars - 1;
+        }
+        line += lex_popcount(newlines);
+        pos += LexBlock::width;
+    }
+#endif
+    return lex_find_block_comment_end_scalar(src, pos, line);
+}
+
+// Find the quote closing a string literal, counting the newlines inside it
+inline size_t lex_find_string_end(std::string_view src, size_t pos, int &line)
+{
+#ifdef LOX_LEX_SIMD
+    while (pos + LexBlock::width <= src.size()) {
+        const LexBlock block(src.data() + pos);
+        const uint32_t newlines = block.eq('\n');
+        const uint32_t quotes = block.eq('"');
+        if (quotes) {
+            const int n = lex_count_trailing_zeros(quotes);
+            line += lex_popcount(newlines & lex_prefix_mask(n));
+            return pos + n;
+        }
+        line += lex_popcount(newlines);
+        pos += LexBlock::width;
+    }
+#endif
+    return lex_find_string_end_scalar(src, pos, line);
+}
+
+// Skip the letters, digits and underscores of an identifier
+inline size_t lex_skip_identifier(std::string_view src, size_t pos)
+{
+#ifdef LOX_LEX_SIMD
+    while (pos + LexBlock::width <= src.size()) {
+        const uint32_t other =
+            ~LexBlock(src.data() + pos).identifier_chars() & lex_prefix_mask(LexBlock::width);
+        if (other) {
+            return pos + lex_count_trailing_zeros(other);
+        }
+        pos += LexBlock::width;
+    }
+#endif
+    return lex_skip_identifier_scalar(src, pos);
+}
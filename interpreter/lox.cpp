@@ -0,0 +1,131 @@
+#include "lox.h"
+#include "ast_printer.h"
+#include "parser.h"
+#include "program_cache.h"
+#include "resolver.h"
+#include "scanner.h"
+
+std::shared_ptr<const Program> compile(std::string_view source,
+                                       ErrorReporter &errors,
+                                       std::ostream *trace,
+                                       bool lazy_functions)
+{
+    errors.had_error = false;
+    errors.had_warning = false;
+
+    Scanner scanner(source, errors);
+    const auto &tokens = scanner.scan_tokens();
+
+    if (trace) {
+        for (const auto &t : tokens) {
+            *trace << t << "\n";
+        }
+    }
+
+    auto program = std::make_shared<Program>();
+    Parser parser(tokens, errors, lazy_functions);
+    program->statements = parser.parse();
+    program->deferred_bodies = std::move(parser.deferred_bodies);
+
+    if (errors.had_error) {
+        return nullptr;
+    }
+
+    Resolver resolver(errors);
+    resolver.resolve(*program);
+
+    if (errors.had_error) {
+        return nullptr;
+    }
+
+    if (trace) {
+        ProgramPrinter printer;
+        *trace << "Program:\n" << printer.print(program->statements) << "------\n";
+    }
+    return program;
+}
+
+std::shared_ptr<const Program> compile_cached(std::string_view source,
+                                              ErrorReporter &errors,
+                                              std::ostream *trace)
+{
+    auto program = load_cached_program(source);
+    if (program) {
+        errors.had_error = false;
+        errors.had_warning = false;
+        if (trace) {
+            ProgramPrinter printer;
+            *trace << "Program:\n" << printer.print(program->statements) << "------\n";
+        }
+        return program;
+    }
+
+    program = compile(source, errors, trace);
+    // Warnings are only reported when the script is compiled, so scripts with
+    // warnings aren't cached to keep reporting them
+    if (program && !errors.had_warning) {
+        store_cached_program(source, *program);
+    }
+    return program;
+}
+
+bool run_program(const std::shared_ptr<const Program> &program, Interpreter &interpreter)
+{
+    interpreter.errors.had_error = false;
+    interpreter.evaluate(program);
+    return !interpreter.errors.had_error;
+}
+
+bool run_streaming(std::string_view source,
+                   Interpreter &interpreter,
+                   std::ostream *trace,
+                   bool lazy_functions)
+{
+    auto &errors = interpreter.errors;
+    errors.had_error = false;
+    errors.had_warning = false;
+
+    Scanner scanner(source, errors);
+    Parser parser(scanner, errors, lazy_functions);
+    // Reuse the resolver for each declaration to keep its storage
+    Resolver resolver(errors);
+    // Set once a compile error or a runtime error escaping a declaration stops
+    // the script, runtime errors caught in nested blocks don't. The reporter's
+    // flag is reset for each declaration to tell its compile errors apart
+    bool stopped = false;
+    bool had_error = false;
+    while (!parser.done()) {
+        errors.had_error = false;
+        auto statement = parser.parse_next();
+        bool compiled = !errors.had_error;
+        if (compiled && !stopped) {
+            auto program = std::make_shared<Program>();
+            program->statements.push_back(statement);
+            program->deferred_bodies = std::move(parser.deferred_bodies);
+            parser.deferred_bodies.clear();
+
+            resolver.resolve(*program);
+            compiled = !errors.had_error;
+            if (compiled) {
+                if (trace) {
+                    ProgramPrinter printer;
+                    *trace << printer.print(program->statements) << "\n";
+                }
+                stopped = !interpreter.evaluate(program);
+            }
+        }
+        stopped = stopped || !compiled;
+        had_error = had_error || errors.had_error;
+    }
+    errors.had_error = had_error;
+    return !had_error;
+}
+
+bool run_script(std::string_view source, Interpreter &interpreter)
+{
+    auto program = compile(source, interpreter.errors);
+    if (!program) {
+        return false;
+    }
+    return run_program(program, interpreter);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "expr.h"
+#include "interpreter.h"
+#include "isolate.h"
+#include "native.h"
+#include "output_sink.h"
+#include "program.h"
+#include "symbol.h"
+
+// The embedding API of liblox. Create an Isolate, optionally with an OutputSink
+// to capture what its scripts print and a stream to report errors to, register
+// any native functions with Interpreter::register_native and then compile and
+// run scripts in it. Independent isolates can be run concurrently on an
+// IsolatePool. A script that's run many times can be compiled once to a Program
+// and the program run in each isolate, without scanning, parsing and resolving
+// it again. The names scripts use are interned for the life of the process, a host
+// running many different scripts can bound them with set_symbol_limit.
+
+// Scan, parse and resolve the script. Returns nullptr if there were errors, which
+// are reported to errors. If trace is set the tokens and the parsed program are
+// written to it. With lazy_functions the bodies of top-level functions are only
+// parsed and resolved when they're first called, and any errors in them are
+// reported then.
+std::shared_ptr<const Program> compile(std::string_view source,
+                                       ErrorReporter &errors,
+                                       std::ostream *trace = nullptr,
+                                       bool lazy_functions = false);
+
+// Compile the script, or load it from the compile cache if it's been compiled
+// before. Scripts that compile without errors or warnings are stored in the
+// cache, see program_cache.h. On a cache hit only the program is written to trace.
+std::shared_ptr<const Program> compile_cached(std::string_view source,
+                                              ErrorReporter &errors,
+                                              std::ostream *trace = nullptr);
+
+// Run the compiled program in the interpreter, returns false if there were
+// runtime errors
+bool run_program(const std::shared_ptr<const Program> &program, Interpreter &interpreter);
+
+// Compile and run the script in the interpreter, returns false if there were
+// compile or runtime errors
+bool run_script(std::string_view source, Interpreter &interpreter);
+
+// Compile and run the script one top-level declaration at a time, each is parsed,
+// resolved and run before the next is scanned. Only the tokens and AST of the
+// current declaration are held in memory, apart from function declarations kept
+// alive by the functions. Declarations are run until there's a compile error or
+// a runtime error stops a declaration, as it stops the top-level statements when
+// the whole script is run. After that the rest of the script is only parsed to
+// report any further compile errors.
+// Returns false if there were compile or runtime errors. If trace is set each
+// declaration is written to it.
+bool run_streaming(std::string_view source,
+                   Interpreter &interpreter,
+                   std::ostream *trace = nullptr,
+                   bool lazy_functions = false);
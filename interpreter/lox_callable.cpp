@@ -1,13 +1,9 @@
 #include "lox_callable.h"
 #include <chrono>
 #include <iostream>
+#include "rope.h"
 
-size_t Clock::arity() const
-{
-    return 0;
-}
-
-std::any Clock::call(Interpreter &, std::vector<std::any> &)
+float native_clock()
 {
     using namespace std::chrono;
     const auto now = steady_clock::now();
@@ -15,25 +11,13 @@ std::any Clock::call(Interpreter &, std::vector<std::any> &)
     return millis / 1000.f;
 }
 
-std::string Clock::to_string() const
-{
-    return "<fn clock>";
-}
-
-size_t CITestAdd::arity() const
+std::any native_ci_test_add(const std::any &left, const std::any &right)
 {
-    return 2;
-}
-
-std::any CITestAdd::call(Interpreter &, std::vector<std::any> &args)
-{
-    auto left = args[0];
-    auto right = args[1];
     std::any result;
     if (left.type() == typeid(float) && right.type() == typeid(float)) {
         result = std::any_cast<float>(left) + std::any_cast<float>(right);
-    } else if (left.type() == typeid(std::string) && right.type() == typeid(std::string)) {
-        result = std::any_cast<std::string>(left) + std::any_cast<std::string>(right);
+    } else if (is_string(left) && is_string(right)) {
+        result = as_string(left) + as_string(right);
     } else {
         throw InterpreterError(
             Token(), "Invalid arguments to _ci_test_add: Must be two numbers of strings");
@@ -41,14 +25,15 @@ std::any CITestAdd::call(Interpreter &, std::vector<std::any> &args)
     return result;
 }
 
-std::string CITestAdd::to_string() const
-{
-    return "<fn _ci_test_add>";
-}
-
 LoxFunction::LoxFunction(const Function &declaration,
-                         const std::shared_ptr<Environment> &closure)
-    : declaration(declaration), closure(closure)
+                         const std::shared_ptr<Environment> &closure,
+                         const std::shared_ptr<const Program> &program,
+                         const std::shared_ptr<DeferredBody> &deferred)
+    : declaration(declaration),
+      closure(closure),
+      program(program),
+      body(declaration.body),
+      deferred(deferred)
 {
 }
 
@@ -59,6 +44,21 @@ size_t LoxFunction::arity() const
 
 std::any LoxFunction::call(Interpreter &interpreter, std::vector<std::any> &args)
 {
+    if (deferred) {
+        compile_body(interpreter);
+    }
+    // If the body can't be compiled the count passes the threshold and it isn't
+    // tried again
+    const auto &jit = interpreter.jit;
+    if (!jit_code && jit.enabled && ++calls == jit.threshold) {
+        jit_code = jit_compile(*body, *program, jit.speculate ? &feedback : nullptr);
+        feedback = TypeFeedback();
+    }
+    // Code whose speculation keeps failing is replaced by generic code
+    if (jit_code && jit_code->speculative && jit_code->deopts > jit.deopt_limit) {
+        jit_code = jit_compile(*body, *program);
+    }
+
     // Create a new environment for the function and set up its local variables
     // with the argument values
     auto environment = std::make_shared<Environment>(closure);
@@ -66,14 +66,44 @@ std::any LoxFunction::call(Interpreter &interpreter, std::vector<std::any> &args
         environment->define(declaration.params[i].lexeme, args[i]);
     }
 
+    // The function may be called from a different program than it was declared in,
+    // e.g. from a later line in the REPL
+    ProgramScope scope(interpreter.program, program.get());
+    if (jit_code) {
+        // Keep the code alive in case a recursive call replaces it
+        auto code = jit_code;
+        FeedbackScope no_feedback(interpreter.feedback, nullptr);
+        return code->run(interpreter, environment);
+    }
+    const bool profile = jit.enabled && jit.speculate && calls < jit.threshold;
+    FeedbackScope profiling(interpreter.feedback, profile ? &feedback : nullptr);
     try {
-        interpreter.execute_block({declaration.body}, environment);
+        interpreter.execute_block({body}, environment);
     } catch (const std::shared_ptr<ReturnControlFlow> &ret) {
         return ret->value;
     }
     return std::any();
 }
 
+void LoxFunction::compile_body(Interpreter &interpreter)
+{
+    const bool ok = deferred->compile();
+    // The body is only compiled once, but each interpreter reports the errors
+    // and warnings from compiling it when it first calls the function
+    if (!reported_diagnostics) {
+        *interpreter.errors.stream << deferred->diagnostics;
+        reported_diagnostics = true;
+    }
+    if (!ok) {
+        throw InterpreterError(declaration.name,
+                               "Can't call " + declaration.name.lexeme +
+                                   ", its body failed to compile");
+    }
+    program = deferred->program;
+    body = program->statements.front();
+    deferred = nullptr;
+}
+
 std::string LoxFunction::to_string() const
 {
     return "<fn " + declaration.name.lexeme + ">";
@@ -16,33 +16,46 @@ struct LoxCallable {
 };
 
 // Native function to return the current time in seconds
-struct Clock : LoxCallable {
-    size_t arity() const override;
-
-    std::any call(Interpreter &interpreter, std::vector<std::any> &args) override;
-
-    std::string to_string() const override;
-};
+float native_clock();
 
 // A test function that adds the two arguments together for CI
-struct CITestAdd : LoxCallable {
-    size_t arity() const override;
-
-    std::any call(Interpreter &interpreter, std::vector<std::any> &args) override;
-
-    std::string to_string() const override;
-};
+std::any native_ci_test_add(const std::any &left, const std::any &right);
 
 // A function defined in Lox
 struct LoxFunction : LoxCallable {
     const Function declaration;
     std::shared_ptr<Environment> closure;
-
-    LoxFunction(const Function &declaration, const std::shared_ptr<Environment> &closure);
+    // The program the function was declared in, which holds the resolved locals
+    // of its body
+    std::shared_ptr<const Program> program;
+    std::shared_ptr<Stmt> body;
+    // Set if the body hasn't been compiled yet, in which case it's compiled on
+    // the first call and program switched to the compiled body
+    std::shared_ptr<DeferredBody> deferred;
+    // The number of times the function's been called, it's compiled to native
+    // code when this reaches the interpreter's JIT threshold
+    size_t calls = 0;
+    // The types seen by the body until it's compiled
+    TypeFeedback feedback;
+    // Set once the body's been compiled, see jit.h
+    std::shared_ptr<JitCode> jit_code;
+
+    LoxFunction(const Function &declaration,
+                const std::shared_ptr<Environment> &closure,
+                const std::shared_ptr<const Program> &program,
+                const std::shared_ptr<DeferredBody> &deferred = nullptr);
 
     size_t arity() const override;
 
     std::any call(Interpreter &interpreter, std::vector<std::any> &args) override;
 
     std::string to_string() const override;
+
+private:
+    // Set once the diagnostics from compiling the deferred body were reported, a
+    // body that failed to compile stays deferred but is only reported once
+    bool reported_diagnostics = false;
+
+    // Compile the deferred body, throws an InterpreterError if it has errors
+    void compile_body(Interpreter &interpreter);
 };
@@ -1,6 +1,10 @@
 #include "lox_class.h"
+#include "native.h"
+#include "number.h"
+#include "rope.h"
+#include "util.h"
 
-LoxClass::LoxClass(const std::string &name) : name(name) {}
+LoxClass::LoxClass(Symbol name) : name(name) {}
 
 size_t LoxClass::arity() const
 {
@@ -14,19 +18,19 @@ std::any LoxClass::call(Interpreter &interpreter, std::vector<std::any> &args)
 
 std::string LoxClass::to_string() const
 {
-    return name;
+    return symbol_name(name);
 }
 
 LoxInstance::LoxInstance(const LoxClass &lc) : lox_class(lc) {}
 
 std::string LoxInstance::to_string() const
 {
-    return lox_class.name + " instance";
+    return symbol_name(lox_class.name) + " instance";
 }
 
 std::any LoxInstance::get(const Token &name)
 {
-    auto fnd = fields.find(name.lexeme);
+    auto fnd = fields.find(name.symbol);
     if (fnd != fields.end()) {
         return fnd->second;
     }
@@ -35,5 +39,31 @@ std::any LoxInstance::get(const Token &name)
 
 void LoxInstance::set(const Token &name, const std::any &value)
 {
-    fields[name.lexeme] = value;
+    fields[name.symbol] = value;
+}
+
+StringBuilder::StringBuilder()
+    : LoxClass(intern("StringBuilder")), append_name(intern("append")),
+      to_string_name(intern("to_string"))
+{
+}
+
+std::any StringBuilder::call(Interpreter &, std::vector<std::any> &)
+{
+    auto instance = std::make_shared<LoxInstance>(*this);
+    auto buffer = std::make_shared<std::string>();
+    instance->fields[append_name] = make_native("append", [buffer](const std::any &val) {
+        if (is_string(val)) {
+            *buffer += as_string(val);
+        } else if (val.type() == typeid(float)) {
+            *buffer += format_number(std::any_cast<float>(val));
+        } else {
+            throw InterpreterError(Token(),
+                                   "Invalid argument to StringBuilder.append: Must be a "
+                                   "string or number but got " +
+                                       pretty_type_name(val));
+        }
+    });
+    instance->fields[to_string_name] = make_native("to_string", [buffer]() { return *buffer; });
+    return instance;
 }
@@ -1,13 +1,14 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include "lox_callable.h"
 
 struct LoxClass : LoxCallable {
-    const std::string name;
+    const Symbol name;
 
-    LoxClass(const std::string &name);
+    LoxClass(Symbol name);
 
     size_t arity() const override;
 
@@ -18,7 +19,7 @@ struct LoxClass : LoxCallable {
 
 struct LoxInstance {
     const LoxClass &lox_class;
-    std::unordered_map<std::string, std::any> fields;
+    std::unordered_map<Symbol, std::any> fields;
 
     LoxInstance(const LoxClass &lox_class);
 
@@ -28,3 +29,16 @@ struct LoxInstance {
 
     void set(const Token &name, const std::any &value);
 };
+
+// Native class for building strings by appending pieces to a single buffer, instead
+// of creating a new string on each concatenation. Instances have two methods:
+// append(value), taking a string or number, and to_string().
+struct StringBuilder : LoxClass {
+    // Interned when the class is created, so calling it doesn't add names
+    const Symbol append_name;
+    const Symbol to_string_name;
+
+    StringBuilder();
+
+    std::any call(Interpreter &interpreter, std::vector<std::any> &args) override;
+};
@@ -0,0 +1,144 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include "lox.h"
+#include "transpiler.h"
+#include "util.h"
+
+#ifndef LOX_RUNTIME_DIR
+#define LOX_RUNTIME_DIR "runtime"
+#endif
+
+// Compiles a Lox script ahead of time to C++ against runtime/lox_runtime.h, then
+// builds that into a native executable or shared object with the system's C++
+// compiler, $CXX or c++ by default
+const std::string usage =
+    "Usage: loxc [--emit-cpp] [--shared] [--runtime=dir] [-o output] script\n"
+    "  --emit-cpp      Write the C++ source instead of building it\n"
+    "  --shared        Build a shared object exporting lox_main\n"
+    "  --runtime=dir   Where lox_runtime.h is, default " LOX_RUNTIME_DIR "\n";
+
+// Quote the argument for the shell
+std::string shell_quote(const std::string &arg)
+{
+    std::string quoted = "'";
+    for (const char c : arg) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+int main(int argc, char **argv)
+{
+    std::string script;
+    std::string output;
+    std::string runtime = LOX_RUNTIME_DIR;
+    bool emit_cpp = false;
+    bool shared = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--emit-cpp") {
+            emit_cpp = true;
+        } else if (arg == "--shared") {
+            shared = true;
+        } else if (arg.rfind("--runtime=", 0) == 0) {
+            runtime = arg.substr(arg.find('=') + 1);
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (script.empty() && arg.rfind("-", 0) != 0) {
+            script = arg;
+        } else {
+            std::cerr << usage;
+            return 1;
+        }
+    }
+    if (script.empty()) {
+        std::cerr << usage;
+        return 1;
+    }
+    if (output.empty()) {
+        // script.lox compiles to script, script.cpp or script.so. Other scripts
+        // get a suffix, so the output is never the script itself
+        const bool lox = script.size() > 4 && script.compare(script.size() - 4, 4, ".lox") == 0;
+        output = lox ? script.substr(0, script.size() - 4) : script;
+        output += emit_cpp ? ".cpp" : shared ? ".so" : lox ? "" : ".out";
+    }
+    std::error_code ec;
+    if (output == script || std::filesystem::equivalent(output, script, ec)) {
+        std::cerr << "loxc: Writing " << output << " would overwrite the script\n";
+        return 1;
+    }
+
+    std::string source;
+    try {
+        source = get_file_content(script);
+    } catch (const std::runtime_error &e) {
+        std::cerr << "loxc: " << e.what() << "\n";
+        return 1;
+    }
+    std::string code;
+    try {
+        ErrorReporter errors;
+        auto program = compile(source, errors);
+        if (!program) {
+            return 1;
+        }
+        code = transpile(*program);
+    } catch (const std::exception &e) {
+        std::cerr << "loxc: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (emit_cpp) {
+        std::ofstream file(output);
+        file << code;
+        if (!file) {
+            std::cerr << "loxc: Failed to write " << output << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    // The C++ source is only needed while it's built, so it goes to a new file
+    // in the temporary directory rather than anywhere the user could have a file
+    std::string cpp_file = (std::filesystem::temp_directory_path(ec) / "loxc-XXXXXX.cpp").string();
+    const int fd = mkstemps(cpp_file.data(), 4);
+    if (fd == -1) {
+        std::cerr << "loxc: Failed to create a temporary file for the C++ source\n";
+        return 1;
+    }
+    close(fd);
+    {
+        std::ofstream file(cpp_file);
+        file << code;
+        if (!file) {
+            std::cerr << "loxc: Failed to write " << cpp_file << "\n";
+            std::remove(cpp_file.c_str());
+            return 1;
+        }
+    }
+
+    const char *cxx = std::getenv("CXX");
+    std::string command = cxx && *cxx ? cxx : "c++";
+    command += " -std=c++17 -O2 -I" + shell_quote(runtime);
+    if (shared) {
+        command += " -shared -fPIC -DLOX_NO_MAIN";
+    }
+    command += " " + shell_quote(cpp_file) + " -o " + shell_quote(output);
+    const int status = std::system(command.c_str());
+    std::remove(cpp_file.c_str());
+    if (status != 0) {
+        std::cerr << "loxc: Failed to build " << output << "\n";
+        return 1;
+    }
+    return 0;
+}
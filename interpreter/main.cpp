@@ -1,88 +1,127 @@
-#include <fstream>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include "ast_printer.h"
 #include "expr.h"
 #include "interpreter.h"
-#include "parser.h"
-#include "resolver.h"
-#include "scanner.h"
-#include "token.h"
-#include "util.h"
+#include "lox.h"
+#include "mapped_file.h"
+#include "output_sink.h"
+#include "symbol.h"
 
-void run_file(const std::string &file);
-void run_prompt();
-void run(const std::string &source, Interpreter &interpreter);
+struct RunOptions {
+    bool use_cache = true;
+    bool lazy_functions = false;
+    bool stream = false;
+    JitOptions jit;
+};
+
+void run_file(const std::string &file,
+              const std::shared_ptr<OutputSink> &output,
+              const RunOptions &options);
+void run_prompt(const std::shared_ptr<OutputSink> &output, const RunOptions &options);
+void run(std::string_view source, Interpreter &interpreter, const RunOptions &options);
+
+const std::string usage =
+    "Usage: interpreter [--flush=newline|size|exit] [--no-cache] [--lazy] [--stream]\n"
+    "                   [--no-jit] [--jit-threshold=N] [--osr-threshold=N] [--no-speculation]\n"
+    "                   [--max-symbols=N] [script | -]\n";
 
 int main(int argc, char **argv)
 {
-    if (argc > 2) {
-        std::cerr << "Usage: interpreter [script]\n";
-        return 1;
+    std::string script;
+    RunOptions options;
+    std::shared_ptr<OutputSink> output = make_stdout_sink();
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--flush=newline") {
+            output = make_stdout_sink(FlushPolicy::NEWLINE);
+        } else if (arg == "--flush=size") {
+            output = make_stdout_sink(FlushPolicy::SIZE);
+        } else if (arg == "--flush=exit") {
+            output = make_stdout_sink(FlushPolicy::EXIT);
+        } else if (arg == "--no-cache") {
+            options.use_cache = false;
+        } else if (arg == "--lazy") {
+            options.lazy_functions = true;
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if (arg == "--no-jit") {
+            options.jit.enabled = false;
+        } else if (arg == "--no-speculation") {
+            options.jit.speculate = false;
+        } else if (arg.rfind("--jit-threshold=", 0) == 0) {
+            options.jit.threshold = std::stoul(arg.substr(arg.find('=') + 1));
+        } else if (arg.rfind("--osr-threshold=", 0) == 0) {
+            options.jit.osr_threshold = std::stoul(arg.substr(arg.find('=') + 1));
+        } else if (arg.rfind("--max-symbols=", 0) == 0) {
+            set_symbol_limit(std::stoul(arg.substr(arg.find('=') + 1)));
+        } else if (script.empty() && arg.rfind("--", 0) != 0) {
+            script = arg;
+        } else {
+            std::cerr << usage;
+            return 1;
+        }
     }
 
-    if (argc == 2) {
-        run_file(argv[1]);
+    if (!script.empty()) {
+        run_file(script, output, options);
     } else {
-        run_prompt();
+        // REPL lines aren't cached
+        options.use_cache = false;
+        run_prompt(output, options);
     }
 
     return 0;
 }
 
-void run_file(const std::string &file)
+void run_file(const std::string &file,
+              const std::shared_ptr<OutputSink> &output,
+              const RunOptions &options)
 {
     try {
-        Interpreter interpreter;
-        run(get_file_content(file), interpreter);
-        if (had_error) {
+        Interpreter interpreter(output);
+        interpreter.jit = options.jit;
+        MappedFile source(file);
+        run(source.data(), interpreter, options);
+        output->flush();
+        if (interpreter.errors.had_error) {
             std::exit(1);
         }
     } catch (const std::runtime_error &e) {
+        output->flush();
         std::cerr << "interpreter error: " << e.what() << "\n";
         std::exit(1);
     }
 }
 
-void run_prompt()
+void run_prompt(const std::shared_ptr<OutputSink> &output, const RunOptions &options)
 {
     std::cout << "> ";
     std::string line;
-    Interpreter interpreter;
+    Interpreter interpreter(output);
+    interpreter.jit = options.jit;
     while (std::getline(std::cin, line)) {
-        run(line, interpreter);
+        run(line, interpreter, options);
+        output->flush();
         std::cout << "> ";
-        had_error = false;
+        interpreter.errors.had_error = false;
     }
 }
 
-void run(const std::string &source, Interpreter &interpreter)
+void run(std::string_view source, Interpreter &interpreter, const RunOptions &options)
 {
-    Scanner scanner(source);
-    const auto &tokens = scanner.scan_tokens();
-
-    for (const auto &t : tokens) {
-        std::cerr << t << "\n";
-    }
-
-    Parser parser(tokens);
-    const auto statements = parser.parse();
-
-    if (had_error) {
+    if (options.stream) {
+        run_streaming(source, interpreter, &std::cerr, options.lazy_functions);
         return;
     }
 
-    Resolver resolver(interpreter);
-    resolver.resolve(statements);
-
-    if (had_error) {
-        return;
+    // Cached programs are already fully compiled, so deferring function bodies
+    // only applies when compiling
+    auto program = options.use_cache && !options.lazy_functions
+                       ? compile_cached(source, interpreter.errors, &std::cerr)
+                       : compile(source, interpreter.errors, &std::cerr, options.lazy_functions);
+    if (program) {
+        interpreter.evaluate(program);
     }
-
-    ProgramPrinter printer;
-    std::cerr << "Program:\n" << printer.print(statements) << "------\n";
-
-    interpreter.evaluate(statements);
 }
-
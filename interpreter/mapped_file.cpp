@@ -0,0 +1,102 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#ifdef _WIN32
+#include <iostream>
+#include <iterator>
+#include "util.h"
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &fname)
+{
+    if (fname == "-") {
+        content = std::string{std::istreambuf_iterator<char>{std::cin},
+                              std::istreambuf_iterator<char>{}};
+    } else {
+        content = get_file_content(fname);
+    }
+}
+
+MappedFile::~MappedFile() {}
+#else
+namespace {
+
+void read_all(int fd, std::string &content, const std::string &fname)
+{
+    char buf[64 * 1024];
+    while (true) {
+        const auto n = read(fd, buf, sizeof(buf));
+        if (n == 0) {
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Failed to read " + fname);
+        }
+        content.append(buf, n);
+    }
+}
+
+}
+
+MappedFile::MappedFile(const std::string &fname)
+{
+    const bool is_stdin = fname == "-";
+    const int fd = is_stdin ? STDIN_FILENO : open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + fname);
+    }
+
+    try {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            throw std::runtime_error("Failed to stat " + fname);
+        }
+
+        // Empty files can't be mapped, they're just left as an empty view
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                mapping = static_cast<const char *>(addr);
+                length = st.st_size;
+                // The scanner reads straight through the file
+                madvise(addr, length, MADV_SEQUENTIAL);
+            }
+        }
+        if (!mapping && (!S_ISREG(st.st_mode) || st.st_size > 0)) {
+            read_all(fd, content, fname);
+        }
+    } catch (const std::runtime_error &) {
+        if (!is_stdin) {
+            close(fd);
+        }
+        throw;
+    }
+    if (!is_stdin) {
+        close(fd);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapping) {
+        munmap(const_cast<char *>(mapping), length);
+    }
+}
+#endif
+
+std::string_view MappedFile::data() const
+{
+    if (mapping) {
+        return std::string_view(mapping, length);
+    }
+    return content;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// A read-only view of a file's contents. Regular files are memory mapped where
+// supported so their contents are never copied, other files such as pipes are
+// read into memory. The file name "-" reads stdin.
+class MappedFile {
+    const char *mapping = nullptr;
+    size_t length = 0;
+    std::string content;
+
+public:
+    // Throws std::runtime_error if the file can't be opened
+    MappedFile(const std::string &fname);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &f) = delete;
+    MappedFile &operator=(const MappedFile &f) = delete;
+
+    std::string_view data() const;
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <any>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "interpreter.h"
+#include "lox_callable.h"
+#include "rope.h"
+#include "util.h"
+
+// Conversion between Lox values and the C++ types native functions can take as
+// arguments and return
+template <typename T>
+struct NativeType;
+
+template <>
+struct NativeType<float> {
+    static constexpr const char *name = "float";
+
+    static bool is(const std::any &val)
+    {
+        return val.type() == typeid(float);
+    }
+
+    static float from_lox(const std::any &val)
+    {
+        return std::any_cast<float>(val);
+    }
+
+    static std::any to_lox(float x)
+    {
+        return x;
+    }
+};
+
+template <>
+struct NativeType<double> {
+    static constexpr const char *name = "float";
+
+    static bool is(const std::any &val)
+    {
+        return val.type() == typeid(float);
+    }
+
+    static double from_lox(const std::any &val)
+    {
+        return std::any_cast<float>(val);
+    }
+
+    static std::any to_lox(double x)
+    {
+        return static_cast<float>(x);
+    }
+};
+
+template <>
+struct NativeType<int> {
+    static constexpr const char *name = "float";
+
+    static bool is(const std::any &val)
+    {
+        return val.type() == typeid(float);
+    }
+
+    static int from_lox(const std::any &val)
+    {
+        return static_cast<int>(std::any_cast<float>(val));
+    }
+
+    static std::any to_lox(int x)
+    {
+        return static_cast<float>(x);
+    }
+};
+
+template <>
+struct NativeType<bool> {
+    static constexpr const char *name = "bool";
+
+    static bool is(const std::any &val)
+    {
+        return val.type() == typeid(bool);
+    }
+
+    static bool from_lox(const std::any &val)
+    {
+        return std::any_cast<bool>(val);
+    }
+
+    static std::any to_lox(bool x)
+    {
+        return x;
+    }
+};
+
+template <>
+struct NativeType<std::string> {
+    static constexpr const char *name = "string";
+
+    static bool is(const std::any &val)
+    {
+        return is_string(val);
+    }
+
+    // Ropes are flattened when passed to a native function
+    static const std::string &from_lox(const std::any &val)
+    {
+        return as_string(val);
+    }
+
+    static std::any to_lox(const std::string &x)
+    {
+        return x;
+    }
+};
+
+// Natives taking or returning std::any handle the Lox values directly
+template <>
+struct NativeType<std::any> {
+    static constexpr const char *name = "any";
+
+    static bool is(const std::any &)
+    {
+        return true;
+    }
+
+    static const std::any &from_lox(const std::any &val)
+    {
+        return val;
+    }
+
+    static std::any to_lox(const std::any &x)
+    {
+        return x;
+    }
+};
+
+// A native C++ function callable from Lox. The arity and argument conversions
+// are derived from the function signature
+template <typename R, typename... Args>
+struct NativeFunction : LoxCallable {
+    const std::string name;
+    std::function<R(Args...)> fn;
+
+    NativeFunction(const std::string &name, const std::function<R(Args...)> &fn);
+
+    size_t arity() const override;
+
+    std::any call(Interpreter &interpreter, std::vector<std::any> &args) override;
+
+    std::string to_string() const override;
+
+private:
+    template <size_t... I>
+    std::any invoke(std::vector<std::any> &args, std::index_sequence<I...>);
+
+    // Check the argument can be converted to the parameter type, if not throws an
+    // InterpreterError
+    template <typename T>
+    void check_arg(const std::any &arg, size_t i) const;
+};
+
+// Wrap the function, lambda or functor in a NativeFunction
+template <typename R, typename... Args>
+std::shared_ptr<LoxCallable> make_native(const std::string &name,
+                                         const std::function<R(Args...)> &fn);
+
+template <typename Fn>
+std::shared_ptr<LoxCallable> make_native(const std::string &name, Fn fn);
+
+template <typename R, typename... Args>
+NativeFunction<R, Args...>::NativeFunction(const std::string &name,
+                                           const std::function<R(Args...)> &fn)
+    : name(name), fn(fn)
+{
+}
+
+template <typename R, typename... Args>
+size_t NativeFunction<R, Args...>::arity() const
+{
+    return sizeof...(Args);
+}
+
+template <typename R, typename... Args>
+std::any NativeFunction<R, Args...>::call(Interpreter &, std::vector<std::any> &args)
+{
+    return invoke(args, std::index_sequence_for<Args...>());
+}
+
+template <typename R, typename... Args>
+std::string NativeFunction<R, Args...>::to_string() const
+{
+    return "<fn " + name + ">";
+}
+
+template <typename R, typename... Args>
+template <size_t... I>
+std::any NativeFunction<R, Args...>::invoke(std::vector<std::any> &args,
+                                            std::index_sequence<I...>)
+{
+    (check_arg<std::decay_t<Args>>(args[I], I), ...);
+    if constexpr (std::is_void_v<R>) {
+        fn(NativeType<std::decay_t<Args>>::from_lox(args[I])...);
+        return std::any();
+    } else {
+        return NativeType<std::decay_t<R>>::to_lox(
+            fn(NativeType<std::decay_t<Args>>::from_lox(args[I])...));
+    }
+}
+
+template <typename R, typename... Args>
+template <typename T>
+void NativeFunction<R, Args...>::check_arg(const std::any &arg, size_t i) const
+{
+    if (!NativeType<T>::is(arg)) {
+        throw InterpreterError(Token(),
+                               "Invalid argument " + std::to_string(i + 1) + " to " + name +
+                                   ": Expected " + NativeType<T>::name +
+                                   " but got " + pretty_type_name(arg));
+    }
+}
+
+template <typename R, typename... Args>
+std::shared_ptr<LoxCallable> make_native(const std::string &name,
+                                         const std::function<R(Args...)> &fn)
+{
+    return std::make_shared<NativeFunction<R, Args...>>(name, fn);
+}
+
+template <typename Fn>
+std::shared_ptr<LoxCallable> make_native(const std::string &name, Fn fn)
+{
+    // Let std::function deduce the signature of the callable
+    return make_native(name, std::function(fn));
+}
+
+template <typename Fn>
+void Interpreter::register_native(const std::string &name, Fn fn)
+{
+    globals->define(name, make_native(name, fn));
+}
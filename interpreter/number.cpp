@@ -0,0 +1,22 @@
+#include "number.h"
+#include <array>
+#include <charconv>
+#include <stdexcept>
+
+std::string format_number(float x)
+{
+    // Enough for the longest shortest round trip float, e.g. -1.17549435e-38
+    std::array<char, 32> buf;
+    const auto res = std::to_chars(buf.data(), buf.data() + buf.size(), x);
+    return std::string(buf.data(), res.ptr);
+}
+
+float parse_number(std::string_view text)
+{
+    float x = 0.f;
+    const auto res = std::from_chars(text.data(), text.data() + text.size(), x);
+    if (res.ec != std::errc() || res.ptr != text.data() + text.size()) {
+        throw std::runtime_error("Invalid number '" + std::string(text) + "'");
+    }
+    return x;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Format the number as the shortest string which parses back to the same float,
+// e.g. 3 instead of 3.000000
+std::string format_number(float x);
+
+// Parse a number literal without copying it out of the source. Throws a
+// std::runtime_error if the text isn't a valid number
+float parse_number(std::string_view text);
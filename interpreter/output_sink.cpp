@@ -0,0 +1,112 @@
+#include "output_sink.h"
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+FdOutputSink::FdOutputSink(int fd, FlushPolicy policy, size_t capacity)
+    : fd(fd), policy(policy), capacity(capacity)
+{
+    buffer.reserve(capacity);
+}
+
+FdOutputSink::~FdOutputSink()
+{
+    try {
+        flush();
+    } catch (const std::runtime_error &) {
+        // Nowhere left to report a failed write at this point
+    }
+}
+
+void FdOutputSink::write(std::string_view str)
+{
+    if (policy == FlushPolicy::EXIT || buffer.size() + str.size() <= capacity) {
+        buffer.append(str.data(), str.size());
+        if (policy == FlushPolicy::NEWLINE && str.find('\n') != std::string_view::npos) {
+            flush();
+        }
+    } else {
+        write_out(str);
+    }
+}
+
+void FdOutputSink::flush()
+{
+    if (!buffer.empty()) {
+        write_out(std::string_view());
+    }
+}
+
+void FdOutputSink::write_out(std::string_view str)
+{
+    std::array<std::string_view, 2> pending = {std::string_view(buffer), str};
+    size_t next = 0;
+    while (next < pending.size()) {
+        if (pending[next].empty()) {
+            ++next;
+            continue;
+        }
+#ifdef _WIN32
+        const auto written = _write(fd, pending[next].data(), pending[next].size());
+#else
+        std::array<iovec, 2> iov;
+        int count = 0;
+        for (size_t i = next; i < pending.size(); ++i) {
+            iov[count].iov_base = const_cast<char *>(pending[i].data());
+            iov[count].iov_len = pending[i].size();
+            ++count;
+        }
+        const auto written = writev(fd, iov.data(), count);
+#endif
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            buffer.clear();
+            throw std::runtime_error("Failed to write output");
+        }
+        // Skip over what was written, which may end partway through a piece
+        size_t remaining = written;
+        while (next < pending.size() && remaining >= pending[next].size()) {
+            remaining -= pending[next].size();
+            ++next;
+        }
+        if (next < pending.size()) {
+            pending[next].remove_prefix(remaining);
+        }
+    }
+    buffer.clear();
+}
+
+void StringOutputSink::write(std::string_view str)
+{
+    output.append(str.data(), str.size());
+}
+
+void StringOutputSink::flush() {}
+
+std::shared_ptr<FdOutputSink> make_stdout_sink()
+{
+#ifdef _WIN32
+    const bool terminal = _isatty(_fileno(stdout));
+#else
+    const bool terminal = isatty(STDOUT_FILENO);
+#endif
+    return make_stdout_sink(terminal ? FlushPolicy::NEWLINE : FlushPolicy::SIZE);
+}
+
+std::shared_ptr<FdOutputSink> make_stdout_sink(FlushPolicy policy)
+{
+#ifdef _WIN32
+    return std::make_shared<FdOutputSink>(_fileno(stdout), policy);
+#else
+    return std::make_shared<FdOutputSink>(STDOUT_FILENO, policy);
+#endif
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Where the interpreter writes the output of print statements
+struct OutputSink {
+    virtual ~OutputSink() = default;
+
+    virtual void write(std::string_view str) = 0;
+
+    virtual void flush() = 0;
+};
+
+// When a buffered sink writes its buffer out
+enum class FlushPolicy {
+    // After each write containing a newline, for interactive use
+    NEWLINE,
+    // When the buffer is full
+    SIZE,
+    // Only on an explicit flush or when the sink is destroyed, the buffer grows
+    // to hold all the output until then
+    EXIT
+};
+
+// Buffers output to a file descriptor, writing the buffer out in large batches.
+// Writes which don't fit in the buffer are sent along with it in a single writev.
+struct FdOutputSink : OutputSink {
+    FdOutputSink(int fd, FlushPolicy policy, size_t capacity = 64 * 1024);
+
+    ~FdOutputSink() override;
+
+    FdOutputSink(const FdOutputSink &s) = delete;
+    FdOutputSink &operator=(const FdOutputSink &s) = delete;
+
+    void write(std::string_view str) override;
+
+    void flush() override;
+
+private:
+    int fd;
+    FlushPolicy policy;
+    size_t capacity;
+    std::string buffer;
+
+    // Write the buffer followed by str to the file, and clear the buffer
+    void write_out(std::string_view str);
+};
+
+// Collects the output in memory, for embedding the interpreter
+struct StringOutputSink : OutputSink {
+    std::string output;
+
+    void write(std::string_view str) override;
+
+    void flush() override;
+};
+
+// Create a sink writing to stdout. By default it's flushed on newlines when stdout
+// is a terminal, and when the buffer fills up otherwise
+std::shared_ptr<FdOutputSink> make_stdout_sink();
+
+std::shared_ptr<FdOutputSink> make_stdout_sink(FlushPolicy policy);
@@ -1,35 +1,72 @@
 #include "parser.h"
-#include <iostream>
 
 ParseError::ParseError() : runtime_error("ParseError") {}
 
-Parser::Parser(const std::vector<Token> &tokens) : tokens(tokens) {}
+Parser::Parser(const std::vector<Token> &tokens, ErrorReporter &errors, bool lazy_functions)
+    : tokens(tokens), errors(errors), lazy_functions(lazy_functions)
+{
+}
+
+Parser::Parser(Scanner &scanner, ErrorReporter &errors, bool lazy_functions)
+    : tokens({scanner.next_token()}),
+      errors(errors),
+      scanner(&scanner),
+      lazy_functions(lazy_functions)
+{
+}
 
 std::vector<std::shared_ptr<Stmt>> Parser::parse()
 {
     std::vector<std::shared_ptr<Stmt>> statements;
     while (!at_end()) {
-        statements.push_back(declaration());
+        statements.push_back(declaration(true));
     }
     return statements;
 }
 
-std::shared_ptr<Stmt> Parser::declaration()
+std::shared_ptr<Stmt> Parser::parse_next()
+{
+    // Drop the tokens of the previous declarations, keeping the last one read
+    // for previous()
+    if (scanner && current > 1) {
+        tokens.erase(tokens.begin(), tokens.begin() + current - 1);
+        current = 1;
+    }
+    return declaration(true);
+}
+
+bool Parser::done() const
+{
+    return at_end();
+}
+
+std::shared_ptr<Stmt> Parser::parse_function_body()
 {
     try {
-        if (match({TokenType::FUN})) {
-            return function("function");
+        consume(TokenType::LEFT_BRACE, "Expected '{' before function body");
+        return block_statement();
+    } catch (const std::runtime_error &e) {
+        *errors.stream << "interpreter error: " << e.what() << "\n";
+        return nullptr;
+    }
+}
+
+std::shared_ptr<Stmt> Parser::declaration(bool top_level)
+{
+    try {
+        if (match(TokenType::FUN)) {
+            return function("function", top_level && lazy_functions);
         }
-        if (match({TokenType::CLASS})) {
+        if (match(TokenType::CLASS)) {
             return class_statement();
         }
-        if (match({TokenType::VAR})) {
+        if (match(TokenType::VAR)) {
             return var_declaration();
         }
 
         return statement();
     } catch (const std::runtime_error &e) {
-        std::cerr << "interpreter error: " << e.what() << "\n";
+        *errors.stream << "interpreter error: " << e.what() << "\n";
         synchronize();
         return nullptr;
     }
@@ -40,7 +77,7 @@ std::shared_ptr<Stmt> Parser::var_declaration()
     Token name = consume(TokenType::IDENTIFIER, "Expected variable name in declaration");
 
     std::shared_ptr<Expr> initializer = nullptr;
-    if (match({TokenType::EQUAL})) {
+    if (match(TokenType::EQUAL)) {
         initializer = expression();
     }
 
@@ -50,22 +87,22 @@ std::shared_ptr<Stmt> Parser::var_declaration()
 
 std::shared_ptr<Stmt> Parser::statement()
 {
-    if (match({TokenType::IF})) {
+    if (match(TokenType::IF)) {
         return if_statement();
     }
-    if (match({TokenType::WHILE})) {
+    if (match(TokenType::WHILE)) {
         return while_statement();
     }
-    if (match({TokenType::FOR})) {
+    if (match(TokenType::FOR)) {
         return for_statement();
     }
-    if (match({TokenType::PRINT})) {
+    if (match(TokenType::PRINT)) {
         return print_statement();
     }
-    if (match({TokenType::RETURN})) {
+    if (match(TokenType::RETURN)) {
         return return_statement();
     }
-    if (match({TokenType::LEFT_BRACE})) {
+    if (match(TokenType::LEFT_BRACE)) {
         return block_statement();
     }
     return expression_statement();
@@ -79,7 +116,7 @@ std::shared_ptr<Stmt> Parser::if_statement()
 
     auto then_branch = statement();
     std::shared_ptr<Stmt> else_branch;
-    if (match({TokenType::ELSE})) {
+    if (match(TokenType::ELSE)) {
         else_branch = statement();
     }
 
@@ -108,8 +145,8 @@ std::shared_ptr<Stmt> Parser::for_statement()
 {
     consume(TokenType::LEFT_PAREN, "Expected '(' after 'for'");
     std::shared_ptr<Stmt> initializer;
-    if (!match({TokenType::SEMICOLON})) {
-        if (match({TokenType::VAR})) {
+    if (!match(TokenType::SEMICOLON)) {
+        if (match(TokenType::VAR)) {
             initializer = var_declaration();
         } else {
             initializer = expression_statement();
@@ -165,7 +202,7 @@ std::shared_ptr<Stmt> Parser::block_statement()
     return std::make_shared<Block>(statements);
 }
 
-std::shared_ptr<Stmt> Parser::function(const std::string &kind)
+std::shared_ptr<Stmt> Parser::function(const std::string &kind, bool defer_body)
 {
     Token name = consume(TokenType::IDENTIFIER, "Expected " + kind + " name");
 
@@ -174,18 +211,50 @@ std::shared_ptr<Stmt> Parser::function(const std::string &kind)
     if (!check(TokenType::RIGHT_PAREN)) {
         do {
             if (params.size() >= 255) {
-                error(peek(), kind + " cannot take more than 255 parameters");
+                errors.error(peek(), kind + " cannot take more than 255 parameters");
             }
             params.push_back(consume(TokenType::IDENTIFIER, "Expected parameter name"));
-        } while (match({TokenType::COMMA}));
+        } while (match(TokenType::COMMA));
     }
     consume(TokenType::RIGHT_PAREN, "Expected ')' after parameters");
     consume(TokenType::LEFT_BRACE, "Expected '{' before " + kind + " body");
 
+    if (defer_body) {
+        auto deferred = std::make_shared<DeferredBody>();
+        deferred->name = name;
+        deferred->params = params;
+        deferred->tokens = skip_block();
+        auto f = std::make_shared<Function>(name, params, nullptr);
+        deferred_bodies[f.get()] = deferred;
+        return f;
+    }
+
     auto body = block_statement();
     return std::make_shared<Function>(name, params, body);
 }
 
+std::vector<Token> Parser::skip_block()
+{
+    const int begin = current - 1;
+    int depth = 1;
+    while (depth > 0 && !at_end()) {
+        const auto &t = advance();
+        if (t.type == TokenType::LEFT_BRACE) {
+            ++depth;
+        } else if (t.type == TokenType::RIGHT_BRACE) {
+            --depth;
+        }
+    }
+    if (depth > 0) {
+        errors.error(peek(), "Expect '}' closing block");
+        throw ParseError();
+    }
+
+    std::vector<Token> block(tokens.begin() + begin, tokens.begin() + current);
+    block.push_back(Token(TokenType::END_OF_FILE, previous().line));
+    return block;
+}
+
 std::shared_ptr<Stmt> Parser::return_statement()
 {
     Token keyword = previous();
@@ -211,140 +280,114 @@ std::shared_ptr<Stmt> Parser::class_statement()
     return std::make_shared<Class>(name, methods);
 }
 
-std::shared_ptr<Expr> Parser::expression()
-{
-    return assignment();
-}
-
-std::shared_ptr<Expr> Parser::assignment()
-{
-    auto expr = or_expr();
-
-    if (match({TokenType::EQUAL})) {
-        const Token &equals = previous();
-        auto value = assignment();
-
-        if (auto var = std::dynamic_pointer_cast<Variable>(expr)) {
-            return std::make_shared<Assign>(var->name, value);
-        } else if (auto get = std::dynamic_pointer_cast<Get>(expr)) {
-            return std::make_shared<Set>(get->object, get->name, value);
-        }
-        error(equals, "Expected expression");
-    }
-    return expr;
+const Parser::ParseRule &Parser::rule(TokenType type)
+{
+    // Each token's prefix parser, used when it starts an expression, and infix
+    // parser and precedence, used when it follows one
+    static const auto rules = []() {
+        std::array<ParseRule, size_t(TokenType::END_OF_FILE) + 1> rules = {};
+        auto set = [&](TokenType t, PrefixParser prefix, InfixParser infix, Precedence precedence) {
+            rules[size_t(t)] = ParseRule{prefix, infix, precedence};
+        };
+        set(TokenType::LEFT_PAREN, &Parser::grouping, &Parser::call, Precedence::CALL);
+        set(TokenType::DOT, nullptr, &Parser::get, Precedence::CALL);
+        set(TokenType::MINUS, &Parser::unary, &Parser::binary, Precedence::TERM);
+        set(TokenType::PLUS, nullptr, &Parser::binary, Precedence::TERM);
+        set(TokenType::SLASH, nullptr, &Parser::binary, Precedence::FACTOR);
+        set(TokenType::STAR, nullptr, &Parser::binary, Precedence::FACTOR);
+        set(TokenType::BANG, &Parser::unary, nullptr, Precedence::NONE);
+        set(TokenType::BANG_EQUAL, nullptr, &Parser::binary, Precedence::EQUALITY);
+        set(TokenType::EQUAL, nullptr, &Parser::assignment, Precedence::ASSIGNMENT);
+        set(TokenType::EQUAL_EQUAL, nullptr, &Parser::binary, Precedence::EQUALITY);
+        set(TokenType::GREATER, nullptr, &Parser::binary, Precedence::COMPARISON);
+        set(TokenType::GREATER_EQUAL, nullptr, &Parser::binary, Precedence::COMPARISON);
+        set(TokenType::LESS, nullptr, &Parser::binary, Precedence::COMPARISON);
+        set(TokenType::LESS_EQUAL, nullptr, &Parser::binary, Precedence::COMPARISON);
+        set(TokenType::IDENTIFIER, &Parser::variable, nullptr, Precedence::NONE);
+        set(TokenType::STRING, &Parser::literal, nullptr, Precedence::NONE);
+        set(TokenType::NUMBER, &Parser::literal, nullptr, Precedence::NONE);
+        set(TokenType::AND, nullptr, &Parser::logical, Precedence::AND);
+        set(TokenType::FALSE, &Parser::literal, nullptr, Precedence::NONE);
+        set(TokenType::NIL, &Parser::literal, nullptr, Precedence::NONE);
+        set(TokenType::OR, nullptr, &Parser::logical, Precedence::OR);
+        set(TokenType::TRUE, &Parser::literal, nullptr, Precedence::NONE);
+        return rules;
+    }();
+    return rules[size_t(type)];
 }
 
-std::shared_ptr<Expr> Parser::or_expr()
+std::shared_ptr<Expr> Parser::expression()
 {
-    auto expr = and_expr();
-
-    while (match({TokenType::OR})) {
-        const Token &op = previous();
-        auto right = and_expr();
-        expr = std::make_shared<Logical>(expr, op, right);
-    }
-    return expr;
+    return parse_precedence(Precedence::ASSIGNMENT);
 }
 
-std::shared_ptr<Expr> Parser::and_expr()
+std::shared_ptr<Expr> Parser::parse_precedence(Precedence precedence)
 {
-    auto expr = equality();
-
-    while (match({TokenType::AND})) {
-        const Token &op = previous();
-        auto right = equality();
-        expr = std::make_shared<Logical>(expr, op, right);
+    const auto prefix = rule(peek().type).prefix;
+    if (!prefix) {
+        errors.error(peek(), "Expected expression");
+        throw ParseError();
     }
-    return expr;
-}
-
-std::shared_ptr<Expr> Parser::equality()
-{
-    auto expr = comparison();
+    advance();
+    auto expr = (this->*prefix)();
 
-    while (match({TokenType::BANG_EQUAL, TokenType::EQUAL_EQUAL})) {
-        const Token &op = previous();
-        auto right = comparison();
-        expr = std::make_shared<Binary>(expr, op, right);
+    // Keep extending the expression with operators that bind at least as tightly
+    while (precedence <= rule(peek().type).precedence) {
+        advance();
+        expr = (this->*rule(previous().type).infix)(expr);
     }
     return expr;
 }
 
-std::shared_ptr<Expr> Parser::comparison()
+std::shared_ptr<Expr> Parser::assignment(const std::shared_ptr<Expr> &target)
 {
-    auto expr = addition();
+    // Copy the token, reading more tokens can move the ones already read
+    const Token equals = previous();
+    // Assignment is right associative
+    auto value = parse_precedence(Precedence::ASSIGNMENT);
 
-    while (match({TokenType::GREATER,
-                  TokenType::GREATER_EQUAL,
-                  TokenType::LESS,
-                  TokenType::LESS_EQUAL})) {
-        const Token &op = previous();
-        auto right = addition();
-        expr = std::make_shared<Binary>(expr, op, right);
+    if (auto var = std::dynamic_pointer_cast<Variable>(target)) {
+        return std::make_shared<Assign>(var->name, value);
+    } else if (auto get = std::dynamic_pointer_cast<Get>(target)) {
+        return std::make_shared<Set>(get->object, get->name, value);
     }
-    return expr;
+    errors.error(equals, "Expected expression");
+    return target;
 }
 
-std::shared_ptr<Expr> Parser::addition()
+std::shared_ptr<Expr> Parser::logical(const std::shared_ptr<Expr> &left)
 {
-    auto expr = multiplication();
-
-    while (match({TokenType::PLUS, TokenType::MINUS})) {
-        const Token &op = previous();
-        auto right = multiplication();
-        expr = std::make_shared<Binary>(expr, op, right);
-    }
-    return expr;
+    const Token op = previous();
+    auto right = parse_precedence(next(rule(op.type).precedence));
+    return std::make_shared<Logical>(left, op, right);
 }
 
-std::shared_ptr<Expr> Parser::multiplication()
+std::shared_ptr<Expr> Parser::binary(const std::shared_ptr<Expr> &left)
 {
-    auto expr = unary();
-
-    while (match({TokenType::STAR, TokenType::SLASH})) {
-        const Token &op = previous();
-        auto right = unary();
-        expr = std::make_shared<Binary>(expr, op, right);
-    }
-    return expr;
+    // Binary operators are left associative, so the right operand only takes
+    // operators binding more tightly
+    const Token op = previous();
+    auto right = parse_precedence(next(rule(op.type).precedence));
+    return std::make_shared<Binary>(left, op, right);
 }
 
 std::shared_ptr<Expr> Parser::unary()
 {
-    if (match({TokenType::BANG, TokenType::MINUS})) {
-        const Token &op = previous();
-        auto right = unary();
-        return std::make_shared<Unary>(op, right);
-    }
-    return call();
+    const Token op = previous();
+    auto right = parse_precedence(Precedence::UNARY);
+    return std::make_shared<Unary>(op, right);
 }
 
-std::shared_ptr<Expr> Parser::call()
-{
-    auto expr = primary();
-    while (true) {
-        if (match({TokenType::LEFT_PAREN})) {
-            expr = finish_call(expr);
-        } else if (match({TokenType::DOT})) {
-            Token name = consume(TokenType::IDENTIFIER, "Expected property name after '.'");
-            expr = std::make_shared<Get>(expr, name);
-        } else {
-            break;
-        }
-    }
-    return expr;
-}
-
-std::shared_ptr<Expr> Parser::finish_call(std::shared_ptr<Expr> &callee)
+std::shared_ptr<Expr> Parser::call(const std::shared_ptr<Expr> &callee)
 {
     std::vector<std::shared_ptr<Expr>> args;
     if (!check(TokenType::RIGHT_PAREN)) {
         do {
             if (args.size() >= 255) {
-                error(peek(), "Functions cannot take more than 255 arguments");
+                errors.error(peek(), "Functions cannot take more than 255 arguments");
             }
             args.push_back(expression());
-        } while (match({TokenType::COMMA}));
+        } while (match(TokenType::COMMA));
     }
 
     Token paren = consume(TokenType::RIGHT_PAREN, "Expected ')' after arguments");
@@ -352,31 +395,41 @@ std::shared_ptr<Expr> Parser::finish_call(std::shared_ptr<Expr> &callee)
     return std::make_shared<Call>(callee, paren, args);
 }
 
-std::shared_ptr<Expr> Parser::primary()
+std::shared_ptr<Expr> Parser::get(const std::shared_ptr<Expr> &object)
 {
-    if (match({TokenType::FALSE})) {
+    Token name = consume(TokenType::IDENTIFIER, "Expected property name after '.'");
+    return std::make_shared<Get>(object, name);
+}
+
+std::shared_ptr<Expr> Parser::literal()
+{
+    switch (previous().type) {
+    case TokenType::FALSE:
         return std::make_shared<Literal>(false);
-    }
-    if (match({TokenType::TRUE})) {
+    case TokenType::TRUE:
         return std::make_shared<Literal>(true);
-    }
-    if (match({TokenType::NIL})) {
+    case TokenType::NIL:
         return std::make_shared<Literal>(std::any());
-    }
-    if (match({TokenType::NUMBER, TokenType::STRING})) {
+    default:
         return std::make_shared<Literal>(previous().literal);
     }
-    if (match({TokenType::IDENTIFIER})) {
-        return std::make_shared<Variable>(previous());
-    }
-    if (match({TokenType::LEFT_PAREN})) {
-        auto expr = expression();
-        consume(TokenType::RIGHT_PAREN, "Expected ')' after expression");
-        return std::make_shared<Grouping>(expr);
-    }
+}
 
-    error(peek(), "Expected expression");
-    throw ParseError();
+std::shared_ptr<Expr> Parser::variable()
+{
+    return std::make_shared<Variable>(previous());
+}
+
+std::shared_ptr<Expr> Parser::grouping()
+{
+    auto expr = expression();
+    consume(TokenType::RIGHT_PAREN, "Expected ')' after expression");
+    return std::make_shared<Grouping>(expr);
+}
+
+Parser::Precedence Parser::next(Precedence precedence)
+{
+    return Precedence(int(precedence) + 1);
 }
 
 void Parser::synchronize()
@@ -405,17 +458,6 @@ void Parser::synchronize()
     }
 }
 
-bool Parser::match(const std::vector<TokenType> &types)
-{
-    for (const auto &t : types) {
-        if (check(t)) {
-            advance();
-            return true;
-        }
-    }
-    return false;
-}
-
 bool Parser::check(const TokenType &t) const
 {
     return !at_end() && peek().type == t;
@@ -430,6 +472,9 @@ const Token &Parser::advance()
 {
     if (!at_end()) {
         ++current;
+        if (scanner && current == int(tokens.size())) {
+            tokens.push_back(scanner->next_token());
+        }
     }
     return previous();
 }
@@ -439,7 +484,7 @@ const Token &Parser::consume(const TokenType &t, const std::string &error_messag
     if (check(t)) {
         return advance();
     }
-    error(peek(), error_message);
+    errors.error(peek(), error_message);
     throw ParseError();
 }
 
@@ -6,7 +6,10 @@
 #include <stdexcept>
 #include <string>
 #include <vector>
+#include "error_reporter.h"
 #include "expr.h"
+#include "program.h"
+#include "scanner.h"
 #include "token.h"
 #include "util.h"
 
@@ -17,14 +20,33 @@ struct ParseError : public std::runtime_error {
 struct Parser {
     std::vector<Token> tokens;
     int current = 0;
+    ErrorReporter &errors;
+    // If set tokens are read from the scanner as they're needed, and only the
+    // tokens of the declaration being parsed are kept
+    Scanner *scanner = nullptr;
+    // Pre-parse the bodies of top-level functions, deferring parsing them
+    // until they're called
+    bool lazy_functions = false;
+    std::unordered_map<const Function *, std::shared_ptr<DeferredBody>> deferred_bodies;
 
-    Parser() = default;
-    Parser(const std::vector<Token> &tokens);
+    Parser(const std::vector<Token> &tokens, ErrorReporter &errors, bool lazy_functions = false);
+
+    Parser(Scanner &scanner, ErrorReporter &errors, bool lazy_functions = false);
 
     std::vector<std::shared_ptr<Stmt>> parse();
 
+    // Parse the next top-level declaration, for running the program as it's
+    // parsed. Returns nullptr if the declaration has errors
+    std::shared_ptr<Stmt> parse_next();
+
+    // Check if all the declarations have been parsed
+    bool done() const;
+
+    // Parse the tokens of a deferred function body, see DeferredBody
+    std::shared_ptr<Stmt> parse_function_body();
+
 private:
-    std::shared_ptr<Stmt> declaration();
+    std::shared_ptr<Stmt> declaration(bool top_level = false);
 
     std::shared_ptr<Stmt> var_declaration();
 
@@ -42,39 +64,77 @@ private:
 
     std::shared_ptr<Stmt> block_statement();
 
-    std::shared_ptr<Stmt> function(const std::string &kind);
+    std::shared_ptr<Stmt> function(const std::string &kind, bool defer_body = false);
+
+    // Skip to the '}' matching the '{' just consumed, returning the tokens of the
+    // block followed by an END_OF_FILE
+    std::vector<Token> skip_block();
 
     std::shared_ptr<Stmt> return_statement();
 
     std::shared_ptr<Stmt> class_statement();
 
+    // Expressions are parsed by precedence climbing, with each token's parsing
+    // rule looked up in a table
+    enum class Precedence {
+        NONE,
+        ASSIGNMENT,
+        OR,
+        AND,
+        EQUALITY,
+        COMPARISON,
+        TERM,
+        FACTOR,
+        UNARY,
+        CALL,
+        PRIMARY
+    };
+
+    // Parses an expression starting with the token just consumed
+    using PrefixParser = std::shared_ptr<Expr> (Parser::*)();
+    // Parses the rest of an expression whose left operand has been parsed, and
+    // whose operator is the token just consumed
+    using InfixParser = std::shared_ptr<Expr> (Parser::*)(const std::shared_ptr<Expr> &);
+
+    struct ParseRule {
+        PrefixParser prefix;
+        InfixParser infix;
+        Precedence precedence;
+    };
+
+    static const ParseRule &rule(TokenType type);
+
+    // The next higher precedence
+    static Precedence next(Precedence precedence);
+
     std::shared_ptr<Expr> expression();
 
-    std::shared_ptr<Expr> assignment();
+    // Parse an expression containing operators with at least the precedence
+    std::shared_ptr<Expr> parse_precedence(Precedence precedence);
 
-    std::shared_ptr<Expr> or_expr();
+    std::shared_ptr<Expr> assignment(const std::shared_ptr<Expr> &target);
 
-    std::shared_ptr<Expr> and_expr();
+    std::shared_ptr<Expr> logical(const std::shared_ptr<Expr> &left);
 
-    std::shared_ptr<Expr> equality();
+    std::shared_ptr<Expr> binary(const std::shared_ptr<Expr> &left);
 
-    std::shared_ptr<Expr> comparison();
+    std::shared_ptr<Expr> unary();
 
-    std::shared_ptr<Expr> addition();
+    std::shared_ptr<Expr> call(const std::shared_ptr<Expr> &callee);
 
-    std::shared_ptr<Expr> multiplication();
+    std::shared_ptr<Expr> get(const std::shared_ptr<Expr> &object);
 
-    std::shared_ptr<Expr> unary();
+    std::shared_ptr<Expr> literal();
 
-    std::shared_ptr<Expr> call();
+    std::shared_ptr<Expr> variable();
 
-    std::shared_ptr<Expr> finish_call(std::shared_ptr<Expr> &callee);
-
-    std::shared_ptr<Expr> primary();
+    std::shared_ptr<Expr> grouping();
 
     void synchronize();
 
-    bool match(const std::vector<TokenType> &types);
+    // If the next token is one of the types, consume it and return true
+    template <typename... Types>
+    bool match(Types... types);
 
     bool check(const TokenType &t) const;
 
@@ -88,3 +148,13 @@ private:
 
     const Token &previous() const;
 };
+
+template <typename... Types>
+bool Parser::match(Types... types)
+{
+    if ((check(types) || ...)) {
+        advance();
+        return true;
+    }
+    return false;
+}
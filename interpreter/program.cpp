@@ -0,0 +1,28 @@
+#include "program.h"
+#include <sstream>
+#include "error_reporter.h"
+#include "parser.h"
+#include "resolver.h"
+
+bool DeferredBody::compile()
+{
+    std::call_once(compiled, [this]() {
+        std::ostringstream stream;
+        ErrorReporter errors(stream);
+
+        auto body_program = std::make_shared<Program>();
+        Parser parser(tokens, errors);
+        auto body = parser.parse_function_body();
+        if (!errors.had_error) {
+            Resolver resolver(errors);
+            resolver.resolve_function(*body_program, Function(name, params, body));
+        }
+
+        diagnostics = stream.str();
+        if (!errors.had_error) {
+            body_program->statements.push_back(body);
+            program = body_program;
+        }
+    });
+    return program != nullptr;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "expr.h"
+
+struct Program;
+
+// The body of a top-level function that was only pre-parsed to find its extent.
+// The body is parsed and resolved the first time the function is called, which
+// happens once even if the program is shared between interpreters.
+struct DeferredBody {
+    Token name;
+    std::vector<Token> params;
+    // The tokens of the body block, followed by an END_OF_FILE token
+    std::vector<Token> tokens;
+
+    // Set by compile: the body block as the only statement, along with its
+    // resolved locals
+    std::shared_ptr<const Program> program;
+    // The errors and warnings reported while compiling the body
+    std::string diagnostics;
+
+    // Parse and resolve the body if it hasn't been already, returns false if it
+    // has errors
+    bool compile();
+
+private:
+    std::once_flag compiled;
+};
+
+// A compiled script: the parsed statements and the scope depth each local
+// variable reference was resolved to. A Program isn't modified after it's
+// compiled, so one std::shared_ptr<const Program> can be run by any number of
+// interpreters, including concurrently on different threads. Programs must be
+// created with std::make_shared so functions can keep the program they were
+// declared in alive.
+struct Program : std::enable_shared_from_this<Program> {
+    std::vector<std::shared_ptr<Stmt>> statements;
+    // Track the depth each variable expression is resolved to, expressions
+    // not in the map refer to globals
+    std::unordered_map<const Expr *, size_t> locals;
+    // The top-level functions whose bodies haven't been parsed yet. These are
+    // compiled on demand, but only behind a std::call_once
+    std::unordered_map<const Function *, std::shared_ptr<DeferredBody>> deferred_bodies;
+};
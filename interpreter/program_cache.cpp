@@ -0,0 +1,717 @@
+#include "program_cache.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include "build_id.h"
+#include "mapped_file.h"
+
+namespace {
+
+enum class ExprTag : uint8_t {
+    NONE,
+    ASSIGN,
+    BINARY,
+    CALL,
+    GROUPING,
+    LITERAL,
+    LOGICAL,
+    UNARY,
+    VARIABLE,
+    GET,
+    SET
+};
+
+enum class StmtTag : uint8_t {
+    NONE,
+    BLOCK,
+    EXPRESSION,
+    CLASS,
+    IF,
+    PRINT,
+    VAR,
+    WHILE,
+    FUNCTION,
+    RETURN
+};
+
+enum class ValueTag : uint8_t { NIL, FLOAT, STRING, BOOL };
+
+// Thrown when reading a truncated or otherwise invalid file
+struct FormatError {};
+
+struct ProgramWriter : Expr::Visitor, Stmt::Visitor {
+    std::string &out;
+    const Program &program;
+
+    ProgramWriter(std::string &out, const Program &program) : out(out), program(program) {}
+
+    void write_u8(uint8_t x)
+    {
+        out.push_back(static_cast<char>(x));
+    }
+
+    void write_u32(uint32_t x)
+    {
+        for (int i = 0; i < 4; ++i) {
+            write_u8(x >> (8 * i));
+        }
+    }
+
+    void write_u64(uint64_t x)
+    {
+        for (int i = 0; i < 8; ++i) {
+            write_u8(x >> (8 * i));
+        }
+    }
+
+    void write_string(const std::string &str)
+    {
+        write_u32(str.size());
+        out += str;
+    }
+
+    void write_value(const std::any &val)
+    {
+        if (val.type() == typeid(float)) {
+            uint32_t bits;
+            const float x = std::any_cast<float>(val);
+            std::memcpy(&bits, &x, sizeof(bits));
+            write_u8(uint8_t(ValueTag::FLOAT));
+            write_u32(bits);
+        } else if (val.type() == typeid(std::string)) {
+            write_u8(uint8_t(ValueTag::STRING));
+            write_string(std::any_cast<const std::string &>(val));
+        } else if (val.type() == typeid(bool)) {
+            write_u8(uint8_t(ValueTag::BOOL));
+            write_u8(std::any_cast<bool>(val));
+        } else {
+            write_u8(uint8_t(ValueTag::NIL));
+        }
+    }
+
+    void write_token(const Token &t)
+    {
+        write_u8(uint8_t(t.type));
+        write_string(t.lexeme);
+        write_value(t.literal);
+        write_u32(t.line);
+    }
+
+    // Local variables are written with their depth + 1, and globals as 0
+    void write_depth(const Expr &expr)
+    {
+        auto fnd = program.locals.find(&expr);
+        write_u32(fnd != program.locals.end() ? fnd->second + 1 : 0);
+    }
+
+    void write(const std::shared_ptr<Expr> &expr)
+    {
+        if (expr) {
+            expr->accept(*this);
+        } else {
+            write_u8(uint8_t(ExprTag::NONE));
+        }
+    }
+
+    void write(const std::shared_ptr<Stmt> &stmt)
+    {
+        if (stmt) {
+            stmt->accept(*this);
+        } else {
+            write_u8(uint8_t(StmtTag::NONE));
+        }
+    }
+
+    void write(const std::vector<std::shared_ptr<Stmt>> &statements)
+    {
+        write_u32(statements.size());
+        for (const auto &s : statements) {
+            write(s);
+        }
+    }
+
+    void write_function(const Function &f)
+    {
+        write_token(f.name);
+        write_u32(f.params.size());
+        for (const auto &p : f.params) {
+            write_token(p);
+        }
+        write(f.body);
+    }
+
+    void visit(const Assign &a) override
+    {
+        write_u8(uint8_t(ExprTag::ASSIGN));
+        write_token(a.name);
+        write(a.value);
+        write_depth(a);
+    }
+
+    void visit(const Binary &b) override
+    {
+        write_u8(uint8_t(ExprTag::BINARY));
+        write(b.left);
+        write_token(b.op);
+        write(b.right);
+    }
+
+    void visit(const Call &c) override
+    {
+        write_u8(uint8_t(ExprTag::CALL));
+        write(c.callee);
+        write_token(c.paren);
+        write_u32(c.args.size());
+        for (const auto &a : c.args) {
+            write(a);
+        }
+    }
+
+    void visit(const Grouping &g) override
+    {
+        write_u8(uint8_t(ExprTag::GROUPING));
+        write(g.expr);
+    }
+
+    void visit(const Literal &l) override
+    {
+        write_u8(uint8_t(ExprTag::LITERAL));
+        write_value(l.value);
+    }
+
+    void visit(const Logical &l) override
+    {
+        write_u8(uint8_t(ExprTag::LOGICAL));
+        write(l.left);
+        write_token(l.op);
+        write(l.right);
+    }
+
+    void visit(const Unary &u) override
+    {
+        write_u8(uint8_t(ExprTag::UNARY));
+        write_token(u.op);
+        write(u.expr);
+    }
+
+    void visit(const Variable &v) override
+    {
+        write_u8(uint8_t(ExprTag::VARIABLE));
+        write_token(v.name);
+        write_depth(v);
+    }
+
+    void visit(const Get &g) override
+    {
+        write_u8(uint8_t(ExprTag::GET));
+        write(g.object);
+        write_token(g.name);
+    }
+
+    void visit(const Set &s) override
+    {
+        write_u8(uint8_t(ExprTag::SET));
+        write(s.object);
+        write_token(s.name);
+        write(s.value);
+    }
+
+    void visit(const Block &b) override
+    {
+        write_u8(uint8_t(StmtTag::BLOCK));
+        write(b.statements);
+    }
+
+    void visit(const Expression &e) override
+    {
+        write_u8(uint8_t(StmtTag::EXPRESSION));
+        write(e.expr);
+    }
+
+    void visit(const Class &c) override
+    {
+        write_u8(uint8_t(StmtTag::CLASS));
+        write_token(c.name);
+        write_u32(c.methods.size());
+        for (const auto &m : c.methods) {
+            write_function(*m);
+        }
+    }
+
+    void visit(const If &f) override
+    {
+        write_u8(uint8_t(StmtTag::IF));
+        write(f.condition);
+        write(f.then_branch);
+        write(f.else_branch);
+    }
+
+    void visit(const Print &p) override
+    {
+        write_u8(uint8_t(StmtTag::PRINT));
+        write(p.expr);
+    }
+
+    void visit(const Var &v) override
+    {
+        write_u8(uint8_t(StmtTag::VAR));
+        write_token(v.token);
+        write(v.initializer);
+    }
+
+    void visit(const While &w) override
+    {
+        write_u8(uint8_t(StmtTag::WHILE));
+        write(w.condition);
+        write(w.body);
+    }
+
+    void visit(const Function &f) override
+    {
+        write_u8(uint8_t(StmtTag::FUNCTION));
+        write_function(f);
+    }
+
+    void visit(const Return &r) override
+    {
+        write_u8(uint8_t(StmtTag::RETURN));
+        write_token(r.keyword);
+        write(r.value);
+    }
+};
+
+struct ProgramReader {
+    std::string_view data;
+    size_t pos = 0;
+    Program &program;
+    // The number of local scopes enclosing the node being read, counted as the
+    // resolver does
+    size_t scopes = 0;
+    // How deeply the nodes being read are nested, which is limited so a corrupt
+    // file can't overflow the stack
+    size_t nesting = 0;
+
+    struct Nested {
+        ProgramReader &reader;
+
+        Nested(ProgramReader &reader) : reader(reader)
+        {
+            if (++reader.nesting > LOXC_MAX_NESTING) {
+                throw FormatError();
+            }
+        }
+
+        ~Nested()
+        {
+            --reader.nesting;
+        }
+    };
+
+    ProgramReader(std::string_view data, Program &program) : data(data), program(program) {}
+
+    bool at_end() const
+    {
+        return pos == data.size();
+    }
+
+    std::string_view read_bytes(size_t n)
+    {
+        if (data.size() - pos < n) {
+            throw FormatError();
+        }
+        auto bytes = data.substr(pos, n);
+        pos += n;
+        return bytes;
+    }
+
+    uint8_t read_u8()
+    {
+        return static_cast<uint8_t>(read_bytes(1)[0]);
+    }
+
+    uint32_t read_u32()
+    {
+        const auto bytes = read_bytes(4);
+        uint32_t x = 0;
+        for (int i = 0; i < 4; ++i) {
+            x |= uint32_t(static_cast<uint8_t>(bytes[i])) << (8 * i);
+        }
+        return x;
+    }
+
+    uint64_t read_u64()
+    {
+        const auto bytes = read_bytes(8);
+        uint64_t x = 0;
+        for (int i = 0; i < 8; ++i) {
+            x |= uint64_t(static_cast<uint8_t>(bytes[i])) << (8 * i);
+        }
+        return x;
+    }
+
+    // The number of elements of a list, each of which takes at least a byte, so
+    // a corrupt count fails here instead of allocating a huge vector
+    uint32_t read_count()
+    {
+        const uint32_t count = read_u32();
+        if (data.size() - pos < count) {
+            throw FormatError();
+        }
+        return count;
+    }
+
+    std::string read_string()
+    {
+        const uint32_t size = read_u32();
+        return std::string(read_bytes(size));
+    }
+
+    std::any read_value()
+    {
+        switch (ValueTag(read_u8())) {
+        case ValueTag::NIL:
+            return std::any();
+        case ValueTag::FLOAT: {
+            const uint32_t bits = read_u32();
+            float x;
+            std::memcpy(&x, &bits, sizeof(x));
+            return x;
+        }
+        case ValueTag::STRING:
+            return read_string();
+        case ValueTag::BOOL:
+            return read_u8() != 0;
+        }
+        throw FormatError();
+    }
+
+    Token read_token()
+    {
+        const uint8_t type = read_u8();
+        if (type > uint8_t(TokenType::END_OF_FILE)) {
+            throw FormatError();
+        }
+        auto lexeme = read_string();
+        auto literal = read_value();
+        const int line = read_u32();
+        Token token(TokenType(type), lexeme, literal, line);
+        // Symbols are only valid within a process, so they're interned again
+        if (token.type == TokenType::IDENTIFIER) {
+            token.symbol = intern(token.lexeme);
+        }
+        return token;
+    }
+
+    // A local variable can only be resolved to one of the scopes enclosing it,
+    // the interpreter walks that many environments up without checking
+    void read_depth(const Expr &expr)
+    {
+        const uint32_t depth = read_u32();
+        if (depth > scopes) {
+            throw FormatError();
+        }
+        if (depth != 0) {
+            program.locals[&expr] = depth - 1;
+        }
+    }
+
+    // Nodes which can't be null, a NONE tag is an invalid file
+    std::shared_ptr<Expr> read_expr()
+    {
+        auto expr = read_optional_expr();
+        if (!expr) {
+            throw FormatError();
+        }
+        return expr;
+    }
+
+    std::shared_ptr<Stmt> read_stmt()
+    {
+        auto stmt = read_optional_stmt();
+        if (!stmt) {
+            throw FormatError();
+        }
+        return stmt;
+    }
+
+    std::shared_ptr<Expr> read_optional_expr()
+    {
+        Nested nested(*this);
+        switch (ExprTag(read_u8())) {
+        case ExprTag::NONE:
+            return nullptr;
+        case ExprTag::ASSIGN: {
+            auto name = read_token();
+            auto value = read_expr();
+            auto expr = std::make_shared<Assign>(name, value);
+            read_depth(*expr);
+            return expr;
+        }
+        case ExprTag::BINARY: {
+            auto left = read_expr();
+            auto op = read_token();
+            auto right = read_expr();
+            return std::make_shared<Binary>(left, op, right);
+        }
+        case ExprTag::CALL: {
+            auto callee = read_expr();
+            auto paren = read_token();
+            std::vector<std::shared_ptr<Expr>> args(read_count());
+            for (auto &a : args) {
+                a = read_expr();
+            }
+            return std::make_shared<Call>(callee, paren, args);
+        }
+        case ExprTag::GROUPING:
+            return std::make_shared<Grouping>(read_expr());
+        case ExprTag::LITERAL:
+            return std::make_shared<Literal>(read_value());
+        case ExprTag::LOGICAL: {
+            auto left = read_expr();
+            auto op = read_token();
+            auto right = read_expr();
+            return std::make_shared<Logical>(left, op, right);
+        }
+        case ExprTag::UNARY: {
+            auto op = read_token();
+            auto expr = read_expr();
+            return std::make_shared<Unary>(op, expr);
+        }
+        case ExprTag::VARIABLE: {
+            auto expr = std::make_shared<Variable>(read_token());
+            read_depth(*expr);
+            return expr;
+        }
+        case ExprTag::GET: {
+            auto object = read_expr();
+            auto name = read_token();
+            return std::make_shared<Get>(object, name);
+        }
+        case ExprTag::SET: {
+            auto object = read_expr();
+            auto name = read_token();
+            auto value = read_expr();
+            return std::make_shared<Set>(object, name, value);
+        }
+        }
+        throw FormatError();
+    }
+
+    std::vector<std::shared_ptr<Stmt>> read_statements()
+    {
+        std::vector<std::shared_ptr<Stmt>> statements(read_count());
+        for (auto &s : statements) {
+            s = read_stmt();
+        }
+        return statements;
+    }
+
+    // The parameters are in a scope of their own, enclosing the body's
+    std::shared_ptr<Function> read_function()
+    {
+        auto name = read_token();
+        std::vector<Token> params(read_count());
+        for (auto &p : params) {
+            p = read_token();
+        }
+        ++scopes;
+        auto body = read_stmt();
+        --scopes;
+        return std::make_shared<Function>(name, params, body);
+    }
+
+    std::shared_ptr<Stmt> read_optional_stmt()
+    {
+        Nested nested(*this);
+        switch (StmtTag(read_u8())) {
+        case StmtTag::NONE:
+            return nullptr;
+        case StmtTag::BLOCK: {
+            ++scopes;
+            auto statements = read_statements();
+            --scopes;
+            return std::make_shared<Block>(statements);
+        }
+        case StmtTag::EXPRESSION:
+            return std::make_shared<Expression>(read_expr());
+        case StmtTag::CLASS: {
+            auto name = read_token();
+            std::vector<std::shared_ptr<Function>> methods(read_count());
+            for (auto &m : methods) {
+                m = read_function();
+            }
+            return std::make_shared<Class>(name, methods);
+        }
+        case StmtTag::IF: {
+            auto condition = read_expr();
+            auto then_branch = read_stmt();
+            auto else_branch = read_optional_stmt();
+            return std::make_shared<If>(condition, then_branch, else_branch);
+        }
+        case StmtTag::PRINT:
+            return std::make_shared<Print>(read_expr());
+        case StmtTag::VAR: {
+            auto token = read_token();
+            auto initializer = read_optional_expr();
+            return std::make_shared<Var>(token, initializer);
+        }
+        case StmtTag::WHILE: {
+            auto condition = read_expr();
+            auto body = read_stmt();
+            return std::make_shared<While>(condition, body);
+        }
+        case StmtTag::FUNCTION:
+            return read_function();
+        case StmtTag::RETURN: {
+            auto keyword = read_token();
+            auto value = read_optional_expr();
+            return std::make_shared<Return>(keyword, value);
+        }
+        }
+        throw FormatError();
+    }
+};
+
+std::filesystem::path cache_file(const std::filesystem::path &dir, uint64_t source_hash)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string name(16, '0');
+    for (int i = 15; i >= 0; --i, source_hash >>= 4) {
+        name[i] = digits[source_hash & 0xf];
+    }
+    return dir / (name + ".loxc");
+}
+
+}
+
+const uint64_t LOXC_BUILD_ID = LOX_BUILD_ID;
+
+uint64_t fnv1a(std::string_view data)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const char c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string serialize_program(const Program &program, uint64_t source_hash, size_t source_size)
+{
+    std::string out(LOXC_MAGIC, sizeof(LOXC_MAGIC));
+    ProgramWriter writer(out, program);
+    writer.write_u32(LOXC_VERSION);
+    writer.write_u64(LOXC_BUILD_ID);
+    writer.write_u64(source_hash);
+    writer.write_u64(source_size);
+    std::string payload;
+    ProgramWriter(payload, program).write(program.statements);
+    writer.write_u64(fnv1a(payload));
+    out += payload;
+    return out;
+}
+
+std::shared_ptr<const Program> deserialize_program(std::string_view data,
+                                                   uint64_t source_hash,
+                                                   size_t source_size)
+{
+    auto program = std::make_shared<Program>();
+    ProgramReader reader(data, *program);
+    try {
+        if (reader.read_bytes(sizeof(LOXC_MAGIC)) !=
+                std::string_view(LOXC_MAGIC, sizeof(LOXC_MAGIC)) ||
+            reader.read_u32() != LOXC_VERSION || reader.read_u64() != LOXC_BUILD_ID ||
+            reader.read_u64() != source_hash ||
+            reader.read_u64() != source_size) {
+            return nullptr;
+        }
+        if (reader.read_u64() != fnv1a(data.substr(reader.pos))) {
+            return nullptr;
+        }
+        program->statements = reader.read_statements();
+        if (!reader.at_end()) {
+            return nullptr;
+        }
+    } catch (const FormatError &) {
+        return nullptr;
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    } catch (const std::length_error &) {
+        return nullptr;
+    }
+    return program;
+}
+
+std::filesystem::path cache_dir()
+{
+    if (const char *dir = std::getenv("LOX_CACHE_DIR")) {
+        return dir;
+    }
+    if (const char *dir = std::getenv("XDG_CACHE_HOME")) {
+        return std::filesystem::path(dir) / "lox";
+    }
+    if (const char *home = std::getenv("HOME")) {
+        return std::filesystem::path(home) / ".cache" / "lox";
+    }
+    return std::filesystem::path();
+}
+
+std::shared_ptr<const Program> load_cached_program(std::string_view source)
+{
+    const auto dir = cache_dir();
+    if (dir.empty()) {
+        return nullptr;
+    }
+
+    const uint64_t source_hash = fnv1a(source);
+    const auto fname = cache_file(dir, source_hash);
+    std::error_code ec;
+    if (!std::filesystem::exists(fname, ec)) {
+        return nullptr;
+    }
+    try {
+        MappedFile file(fname.string());
+        return deserialize_program(file.data(), source_hash, source.size());
+    } catch (const std::runtime_error &) {
+        return nullptr;
+    }
+}
+
+void store_cached_program(std::string_view source, const Program &program)
+{
+    const auto dir = cache_dir();
+    if (dir.empty()) {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        return;
+    }
+
+    const uint64_t source_hash = fnv1a(source);
+    const auto data = serialize_program(program, source_hash, source.size());
+
+    // Write to a temporary file and rename it into place, so other processes
+    // never see a partially written file
+    const auto fname = cache_file(dir, source_hash);
+    auto tmp_fname = fname;
+    tmp_fname += "." + std::to_string(std::random_device()()) + ".tmp";
+    {
+        std::ofstream file(tmp_fname, std::ios::binary);
+        if (!file.write(data.data(), data.size())) {
+            file.close();
+            std::filesystem::remove(tmp_fname, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp_fname, fname, ec);
+    if (ec) {
+        std::filesystem::remove(tmp_fname, ec);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "program.h"
+
+// Compiled programs are cached in .loxc files holding a binary serialization of
+// the resolved program, so running an unchanged script again skips scanning,
+// parsing and resolving it. A file starts with a header of the magic "LOXC", the
+// format version, the ID of the build which wrote it, the FNV-1a hash and length
+// of the source it was compiled from, and the FNV-1a hash of the rest of the
+// file, followed by the statements.
+// All integers are little endian. Files which don't match their hash are ignored,
+// and so are files whose AST is nested deeper than LOXC_MAX_NESTING or resolves a
+// variable outside of the scopes enclosing it.
+const char LOXC_MAGIC[4] = {'L', 'O', 'X', 'C'};
+
+// Bump when the file format or the AST changes, files with another version are
+// recompiled
+const uint32_t LOXC_VERSION = 3;
+
+// A hash of the sources of liblox, so programs cached by a build with a
+// different scanner, parser, resolver or AST are compiled again rather than
+// trusting the version to be bumped
+extern const uint64_t LOXC_BUILD_ID;
+
+// Programs nested deeper than this aren't loaded from the cache
+const size_t LOXC_MAX_NESTING = 4096;
+
+// 64-bit FNV-1a hash of the data
+uint64_t fnv1a(std::string_view data);
+
+std::string serialize_program(const Program &program, uint64_t source_hash, size_t source_size);
+
+// Returns nullptr if the data isn't a valid serialization of a program compiled
+// from a source with this hash and length
+std::shared_ptr<const Program> deserialize_program(std::string_view data,
+                                                   uint64_t source_hash,
+                                                   size_t source_size);
+
+// The directory compiled programs are cached in: $LOX_CACHE_DIR if set, otherwise
+// $XDG_CACHE_HOME/lox or ~/.cache/lox. Empty if none of these are set.
+std::filesystem::path cache_dir();
+
+// Load the cached program for the source, returns nullptr if it isn't cached
+std::shared_ptr<const Program> load_cached_program(std::string_view source);
+
+// Store the program compiled from the source in the cache. Failing to write to the
+// cache isn't an error, the script will just be compiled again next time.
+void store_cached_program(std::string_view source, const Program &program);
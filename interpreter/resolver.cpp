@@ -1,8 +1,37 @@
 #include "resolver.h"
-#include <iostream>
-#include "util.h"
 
-Resolver::Resolver(Interpreter &interpreter) : interpreter(interpreter) {}
+namespace {
+
+// The innermost vectors of the thread's destroyed resolvers, cleared back to all
+// zeros. Nested resolvers, such as one compiling a deferred body while a script
+// is streamed, each take their own
+thread_local std::vector<std::vector<uint32_t>> innermost_pool;
+
+}
+
+Resolver::Resolver(ErrorReporter &errors) : errors(errors)
+{
+    if (!innermost_pool.empty()) {
+        innermost = std::move(innermost_pool.back());
+        innermost_pool.pop_back();
+    }
+}
+
+Resolver::~Resolver()
+{
+    // Scopes are still open if resolving was stopped by an exception, only the
+    // entries of their declarations can be set
+    for (const auto &decl : declarations) {
+        innermost[decl.name] = 0;
+    }
+    innermost_pool.push_back(std::move(innermost));
+}
+
+void Resolver::resolve(Program &program)
+{
+    this->program = &program;
+    resolve(program.statements);
+}
 
 void Resolver::visit(const Grouping &g)
 {
@@ -39,12 +68,9 @@ void Resolver::visit(const Logical &l)
 void Resolver::visit(const Variable &v)
 {
     // Check if we're trying to assign the variable to itself on accident
-    if (!scopes.empty()) {
-        auto &scope = scopes.back();
-        auto fnd = scope.find(v.name.lexeme);
-        if (fnd != scope.end() && !fnd->second.defined) {
-            error(v.name, "Can't read local variable in its own initializer");
-        }
+    auto decl = lookup(v.name.symbol);
+    if (decl && decl->scope + 1 == scope_starts.size() && !decl->defined) {
+        errors.error(v.name, "Can't read local variable in its own initializer");
     }
     resolve_local(v, v.name);
 }
@@ -117,7 +143,7 @@ void Resolver::visit(const Function &f)
 void Resolver::visit(const Return &r)
 {
     if (current_function == FunctionType::NONE) {
-        error(r.keyword, "Can't return in top-level code");
+        errors.error(r.keyword, "Can't return in top-level code");
     }
     if (r.value) {
         resolve(r.value);
@@ -132,18 +158,23 @@ void Resolver::visit(const Class &c)
 
 void Resolver::begin_scope()
 {
-    scopes.push_back(std::unordered_map<std::string, VariableStatus>());
+    scope_starts.push_back(declarations.size());
 }
 
 void Resolver::end_scope()
 {
-    // For unused local var: when we pop the scope, check if it was read from
-    for (const auto &v : scopes.back()) {
-        if (!v.second.read) {
-            std::cerr << "Warning: local variable " << v.first << " is never read\n";
+    // For unused local var: when we pop the scope, check if it was read from.
+    // Warnings are reported in the order the variables were declared
+    const size_t start = scope_starts.back();
+    for (size_t i = start; i < declarations.size(); ++i) {
+        const auto &decl = declarations[i];
+        if (!decl.read) {
+            errors.warning("local variable " + symbol_name(decl.name) + " is never read");
         }
+        innermost[decl.name] = decl.shadowed;
     }
-    scopes.pop_back();
+    declarations.resize(start);
+    scope_starts.pop_back();
 }
 
 void Resolver::resolve(const std::vector<std::shared_ptr<Stmt>> &statements)
@@ -165,42 +196,62 @@ void Resolver::resolve(const std::shared_ptr<Expr> &expr)
 
 void Resolver::declare(const Token &name)
 {
-    if (scopes.empty()) {
+    if (scope_starts.empty()) {
         return;
     }
-    auto &scope = scopes.back();
-    auto fnd = scope.find(name.lexeme);
-    if (fnd != scope.end()) {
-        error(name, "A variable with this name already exists in current scope");
+    const uint32_t scope = scope_starts.size() - 1;
+    auto decl = lookup(name.symbol);
+    if (decl && decl->scope == scope) {
+        errors.error(name, "A variable with this name already exists in current scope");
+        *decl = Declaration{name.symbol, scope, decl->shadowed};
+        return;
+    }
+
+    if (name.symbol >= innermost.size()) {
+        innermost.resize(name.symbol + 1, 0);
     }
-    scope[name.lexeme] = VariableStatus();
+    declarations.push_back(Declaration{name.symbol, scope, innermost[name.symbol]});
+    innermost[name.symbol] = declarations.size();
 }
 
 void Resolver::define(const Token &name)
 {
-    if (scopes.empty()) {
+    if (scope_starts.empty()) {
         return;
     }
-    auto &scope = scopes.back();
-    scope[name.lexeme].defined = true;
+    lookup(name.symbol)->defined = true;
+}
+
+Declaration *Resolver::lookup(Symbol name)
+{
+    if (name >= innermost.size() || innermost[name] == 0) {
+        return nullptr;
+    }
+    return &declarations[innermost[name] - 1];
 }
 
 void Resolver::resolve_local(const Expr &expr, const Token &name)
 {
-    // Walk back up the scopes until we find the closest one containing the variable
-    for (int i = scopes.size() - 1; i >= 0; --i) {
-        auto &scope = scopes[i];
-        auto fnd = scope.find(name.lexeme);
-        if (fnd != scope.end()) {
-            fnd->second.read = true;
-            interpreter.resolve(expr, scopes.size() - 1 - i);
-            return;
-        }
+    auto decl = lookup(name.symbol);
+    if (decl) {
+        decl->read = true;
+        program->locals[&expr] = scope_starts.size() - 1 - decl->scope;
     }
 }
 
+void Resolver::resolve_function(Program &program, const Function &f)
+{
+    this->program = &program;
+    resolve_function(f, FunctionType::FUNCTION);
+}
+
 void Resolver::resolve_function(const Function &f, const FunctionType type)
 {
+    // The bodies of deferred functions are resolved when they're compiled
+    if (!f.body) {
+        return;
+    }
+
     auto enclosing_function = current_function;
     current_function = type;
 
@@ -1,30 +1,58 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <unordered_map>
 #include <vector>
-#include "environment.h"
+#include "error_reporter.h"
 #include "expr.h"
-#include "interpreter.h"
+#include "program.h"
 
 enum class FunctionType { NONE, FUNCTION };
 
-struct VariableStatus {
+// A local variable declared in one of the scopes being resolved
+struct Declaration {
+    Symbol name;
+    // The index of the scope the variable is declared in
+    uint32_t scope;
+    // The index + 1 of the declaration of the same name this one shadows, or 0
+    uint32_t shadowed;
     bool defined = false;
     bool read = false;
 };
 
 struct Resolver : Expr::Visitor, Stmt::Visitor {
-    // Treated as a stack, but we need to access scopes by index as well
-    // when resolving variables
-    std::vector<std::unordered_map<std::string, VariableStatus>> scopes;
+    // The local variables in scope, in the order they were declared. Each scope
+    // is a range of the stack starting at its entry in scope_starts, so entering
+    // and leaving scopes doesn't allocate once the vectors have grown
+    std::vector<Declaration> declarations;
+    std::vector<size_t> scope_starts;
+    // The index + 1 of the innermost declaration of each symbol in scope, or 0
+    // if it's not declared in any scope. Resolving a variable is a single lookup
+    // instead of searching each enclosing scope. It's indexed by the process-wide
+    // symbol IDs, so it's taken from a pool of the thread's earlier resolvers
+    // rather than allocated and zeroed for every script and deferred body
+    std::vector<uint32_t> innermost;
     FunctionType current_function = FunctionType::NONE;
 
-    Interpreter &interpreter;
+    // The program the resolved locals are written to
+    Program *program = nullptr;
+    ErrorReporter &errors;
 
-    Resolver(Interpreter &interpreter);
+    // A resolver can be reused to resolve multiple programs, keeping the
+    // storage it's allocated
+    Resolver(ErrorReporter &errors);
 
-    void resolve(const std::vector<std::shared_ptr<Stmt>> &statements);
+    // Returns innermost to the thread's pool
+    ~Resolver();
+
+    Resolver(const Resolver &r) = delete;
+    Resolver &operator=(const Resolver &r) = delete;
+
+    // Resolve the program's statements, writing the depths of its locals to it
+    void resolve(Program &program);
+
+    // Resolve the body of a function declared at the top level on its own
+    void resolve_function(Program &program, const Function &f);
 
     // Visitors for expressions
     void visit(const Grouping &g) override;
@@ -54,12 +82,16 @@ private:
 
     void end_scope();
 
+    void resolve(const std::vector<std::shared_ptr<Stmt>> &statements);
     void resolve(const std::shared_ptr<Stmt> &statement);
     void resolve(const std::shared_ptr<Expr> &expr);
 
     void declare(const Token &name);
     void define(const Token &name);
 
+    // Get the innermost declaration of the name, or nullptr if it's a global
+    Declaration *lookup(Symbol name);
+
     void resolve_local(const Expr &expr, const Token &name);
 
     void resolve_function(const Function &f, const FunctionType type);
@@ -0,0 +1,573 @@
+#pragma once
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// The runtime of Lox programs compiled to C++ by loxc, see transpiler.h. It has
+// the values, closures, classes, instances and native functions of the
+// interpreter, with the same semantics and error messages, so a compiled program
+// prints the same output as the interpreter running the script. It's header only
+// so a compiled program builds from its source file alone.
+namespace loxrt {
+
+struct Callable;
+struct Class;
+struct Instance;
+
+using String = std::shared_ptr<const std::string>;
+
+struct Value {
+    enum Type { NIL, BOOL, NUMBER, STRING, CALLABLE, CLASS, INSTANCE };
+
+    std::variant<std::monostate,
+                 bool,
+                 float,
+                 String,
+                 std::shared_ptr<Callable>,
+                 std::shared_ptr<Class>,
+                 std::shared_ptr<Instance>>
+        v;
+
+    Value() = default;
+
+    explicit Value(bool b) : v(std::in_place_type<bool>, b) {}
+
+    explicit Value(float x) : v(std::in_place_type<float>, x) {}
+
+    explicit Value(const std::string &s)
+        : v(std::in_place_type<String>, std::make_shared<const std::string>(s))
+    {
+    }
+
+    explicit Value(const std::shared_ptr<Callable> &c) : v(c) {}
+
+    explicit Value(const std::shared_ptr<Class> &c) : v(c) {}
+
+    explicit Value(const std::shared_ptr<Instance> &i) : v(i) {}
+
+    Type type() const
+    {
+        return static_cast<Type>(v.index());
+    }
+
+    float number() const
+    {
+        return *std::get_if<float>(&v);
+    }
+
+    const std::string &string() const
+    {
+        return **std::get_if<String>(&v);
+    }
+};
+
+// The token a runtime error is reported at
+struct Site {
+    int line;
+    const char *lexeme;
+};
+
+struct Error {
+    Site site;
+    std::string message;
+};
+
+inline bool had_error = false;
+
+// What print statements write, flushed when it gets large and when the program
+// exits
+inline std::string output;
+
+inline void flush()
+{
+    std::fwrite(output.data(), 1, output.size(), stdout);
+    std::fflush(stdout);
+    output.clear();
+}
+
+inline void write(std::string_view s)
+{
+    output.append(s);
+    if (output.size() > (1 << 16)) {
+        flush();
+    }
+}
+
+[[noreturn]] inline void error(Site site, const std::string &message)
+{
+    throw Error{site, message};
+}
+
+// Report an error in the same format as the interpreter's ErrorReporter
+inline void report(const Error &e)
+{
+    had_error = true;
+    const auto message = "[line " + std::to_string(e.site.line) + "] Error  at '" +
+                         e.site.lexeme + "': " + e.message + "\n";
+    std::fputs(message.c_str(), stderr);
+}
+
+// The shortest string which parses back to the same float, as the interpreter
+// prints numbers
+inline std::string format_number(float x)
+{
+    char buf[32];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), x);
+    return std::string(buf, res.ptr);
+}
+
+inline std::string type_name(const Value &v)
+{
+    switch (v.type()) {
+    case Value::NIL:
+        return "nil";
+    case Value::BOOL:
+        return "bool";
+    case Value::NUMBER:
+        return "float";
+    case Value::STRING:
+        return "string";
+    case Value::CALLABLE:
+        return "function";
+    case Value::CLASS:
+        return "class";
+    case Value::INSTANCE:
+        return "instance";
+    }
+    return "";
+}
+
+struct Callable {
+    virtual ~Callable() = default;
+
+    virtual size_t arity() const = 0;
+
+    virtual Value call(Value *args) = 0;
+
+    virtual std::string to_string() const = 0;
+};
+
+// The variables of a scope captured by closures. Scopes no function is declared
+// in are C++ locals of the compiled code instead
+struct Scope {
+    std::shared_ptr<Scope> parent;
+    std::vector<Value> slots;
+
+    Scope(const std::shared_ptr<Scope> &parent, size_t size) : parent(parent), slots(size) {}
+};
+
+using Code = Value (*)(const std::shared_ptr<Scope> &closure, Value *args);
+
+// A function declared in Lox, compiled to code taking its closure
+struct Function : Callable {
+    const char *name;
+    size_t params;
+    Code code;
+    std::shared_ptr<Scope> closure;
+
+    Function(const char *name, size_t params, Code code, const std::shared_ptr<Scope> &closure)
+        : name(name), params(params), code(code), closure(closure)
+    {
+    }
+
+    size_t arity() const override
+    {
+        return params;
+    }
+
+    Value call(Value *args) override
+    {
+        return code(closure, args);
+    }
+
+    std::string to_string() const override
+    {
+        return std::string("<fn ") + name + ">";
+    }
+};
+
+struct Native : Callable {
+    std::string name;
+    size_t params;
+    std::function<Value(Value *)> fn;
+
+    Native(const std::string &name, size_t params, std::function<Value(Value *)> fn)
+        : name(name), params(params), fn(std::move(fn))
+    {
+    }
+
+    size_t arity() const override
+    {
+        return params;
+    }
+
+    Value call(Value *args) override
+    {
+        return fn(args);
+    }
+
+    std::string to_string() const override
+    {
+        return "<fn " + name + ">";
+    }
+};
+
+// As in the interpreter, classes only create instances to hold fields, their
+// methods aren't bound
+struct Class : Callable, std::enable_shared_from_this<Class> {
+    std::string name;
+
+    Class(const std::string &name) : name(name) {}
+
+    size_t arity() const override
+    {
+        return 0;
+    }
+
+    Value call(Value *args) override;
+
+    std::string to_string() const override
+    {
+        return name;
+    }
+};
+
+struct Instance {
+    std::shared_ptr<const Class> lox_class;
+    std::unordered_map<std::string, Value> fields;
+
+    Instance(const std::shared_ptr<const Class> &lox_class) : lox_class(lox_class) {}
+
+    std::string to_string() const
+    {
+        return lox_class->name + " instance";
+    }
+};
+
+inline Value Class::call(Value *)
+{
+    return Value(std::make_shared<Instance>(shared_from_this()));
+}
+
+// Native class for building strings by appending pieces to a single buffer, see
+// the interpreter's lox_class.h
+struct StringBuilder : Class {
+    StringBuilder() : Class("StringBuilder") {}
+
+    Value call(Value *) override
+    {
+        auto instance = std::make_shared<Instance>(shared_from_this());
+        auto buffer = std::make_shared<std::string>();
+        instance->fields["append"] = Value(std::shared_ptr<Callable>(
+            std::make_shared<Native>("append", 1, [buffer](Value *args) {
+                if (args[0].type() == Value::STRING) {
+                    *buffer += args[0].string();
+                } else if (args[0].type() == Value::NUMBER) {
+                    *buffer += format_number(args[0].number());
+                } else {
+                    error(Site{0, ""},
+                          "Invalid argument to StringBuilder.append: Must be a string or "
+                          "number but got " +
+                              type_name(args[0]));
+                }
+                return Value();
+            })));
+        instance->fields["to_string"] = Value(std::shared_ptr<Callable>(
+            std::make_shared<Native>("to_string", 0, [buffer](Value *) { return Value(*buffer); })));
+        return Value(instance);
+    }
+};
+
+// A global variable, which is looked up when it's used and may not be defined
+struct Global {
+    Value value;
+    bool defined = false;
+};
+
+inline const Value &get(const Global &g, Site name)
+{
+    if (!g.defined) {
+        error(name, "Undefined variable");
+    }
+    return g.value;
+}
+
+inline void assign(Global &g, const Value &value, Site name)
+{
+    if (!g.defined) {
+        error(name, "Undefined variable");
+    }
+    g.value = value;
+}
+
+inline void define(Global &g, const Value &value)
+{
+    g.value = value;
+    g.defined = true;
+}
+
+// Define the global if it's one of the interpreter's native functions
+inline void define_native(Global &g, std::string_view name)
+{
+    if (name == "clock") {
+        define(g, Value(std::shared_ptr<Callable>(std::make_shared<Native>("clock", 0, [](Value *) {
+                   using namespace std::chrono;
+                   const auto now = steady_clock::now();
+                   const float millis = duration_cast<milliseconds>(now.time_since_epoch()).count();
+                   return Value(millis / 1000.f);
+               }))));
+    } else if (name == "_ci_test_add") {
+        define(g, Value(std::shared_ptr<Callable>(
+                      std::make_shared<Native>("_ci_test_add", 2, [](Value *args) {
+                          if (args[0].type() == Value::NUMBER && args[1].type() == Value::NUMBER) {
+                              return Value(args[0].number() + args[1].number());
+                          }
+                          if (args[0].type() == Value::STRING && args[1].type() == Value::STRING) {
+                              return Value(args[0].string() + args[1].string());
+                          }
+                          error(Site{0, ""},
+                                "Invalid arguments to _ci_test_add: Must be two numbers of "
+                                "strings");
+                      }))));
+    } else if (name == "StringBuilder") {
+        define(g, Value(std::shared_ptr<Callable>(std::make_shared<StringBuilder>())));
+    }
+}
+
+inline bool truthy(const Value &x)
+{
+    switch (x.type()) {
+    case Value::NIL:
+        return false;
+    case Value::BOOL:
+        return *std::get_if<bool>(&x.v);
+    case Value::NUMBER:
+        return x.number() != 0.f;
+    default:
+        return true;
+    }
+}
+
+[[noreturn]] inline void expected(const char *types, const Value &v, Site op)
+{
+    error(op, std::string("Expected one of {") + types + "} but got " + type_name(v));
+}
+
+inline void check_same_type(const Value &a, const Value &b, Site op)
+{
+    if (a.type() != b.type()) {
+        error(op, "Expected " + type_name(a) + " but got " + type_name(b));
+    }
+}
+
+// Check the operands of an arithmetic or comparison operator are both numbers
+inline void check_numbers(const Value &a, const Value &b, Site op)
+{
+    check_same_type(a, b, op);
+    if (a.type() != Value::NUMBER) {
+        expected("float", a, op);
+    }
+}
+
+inline Value negate(const Value &right, Site op)
+{
+    if (right.type() != Value::NUMBER) {
+        expected("float", right, op);
+    }
+    return Value(-right.number());
+}
+
+inline Value logical_not(const Value &right)
+{
+    return Value(!truthy(right));
+}
+
+inline Value add(const Value &left, const Value &right, Site op)
+{
+    if (left.type() == Value::NUMBER && right.type() == Value::NUMBER) {
+        return Value(left.number() + right.number());
+    }
+    if (right.type() != Value::NUMBER && right.type() != Value::STRING) {
+        expected("float, string", right, op);
+    }
+    if (left.type() != Value::NUMBER && left.type() != Value::STRING) {
+        expected("float, string", left, op);
+    }
+    if (left.type() == Value::NUMBER) {
+        return Value(format_number(left.number()) + right.string());
+    }
+    if (right.type() == Value::NUMBER) {
+        return Value(left.string() + format_number(right.number()));
+    }
+    return Value(left.string() + right.string());
+}
+
+inline Value subtract(const Value &left, const Value &right, Site op)
+{
+    check_numbers(left, right, op);
+    return Value(left.number() - right.number());
+}
+
+inline Value multiply(const Value &left, const Value &right, Site op)
+{
+    check_numbers(left, right, op);
+    return Value(left.number() * right.number());
+}
+
+inline Value divide(const Value &left, const Value &right, Site op)
+{
+    check_numbers(left, right, op);
+    if (right.number() == 0.f) {
+        error(op, "Division by 0");
+    }
+    return Value(left.number() / right.number());
+}
+
+inline Value less(const Value &left, const Value &right, Site op)
+{
+    check_numbers(left, right, op);
+    return Value(left.number() < right.number());
+}
+
+inline Value less_equal(const Value &left, const Value &right, Site op)
+{
+    check_numbers(left, right, op);
+    return Value(left.number() <= right.number());
+}
+
+inline Value greater(const Value &left, const Value &right, Site op)
+{
+    check_numbers(left, right, op);
+    return Value(left.number() > right.number());
+}
+
+inline Value greater_equal(const Value &left, const Value &right, Site op)
+{
+    check_numbers(left, right, op);
+    return Value(left.number() >= right.number());
+}
+
+// Values of different types are never equal, functions, classes and instances
+// are compared by identity
+inline bool is_equal(const Value &a, const Value &b)
+{
+    if (a.type() != b.type()) {
+        return false;
+    }
+    switch (a.type()) {
+    case Value::NUMBER:
+        return a.number() == b.number();
+    case Value::STRING:
+        return a.string() == b.string();
+    default:
+        return a.v == b.v;
+    }
+}
+
+inline Value equal(const Value &left, const Value &right)
+{
+    return Value(is_equal(left, right));
+}
+
+inline Value not_equal(const Value &left, const Value &right)
+{
+    return Value(!is_equal(left, right));
+}
+
+inline Value call(const Value &callee, Value *args, size_t count, Site paren)
+{
+    Callable *fn = nullptr;
+    if (auto *c = std::get_if<std::shared_ptr<Callable>>(&callee.v)) {
+        fn = c->get();
+    } else if (auto *c = std::get_if<std::shared_ptr<Class>>(&callee.v)) {
+        fn = c->get();
+    } else {
+        error(paren, "Only functions and classes are callable");
+    }
+    if (count != fn->arity()) {
+        error(paren,
+              "Expected " + std::to_string(fn->arity()) + " arguments but got " +
+                  std::to_string(count));
+    }
+    // Natives report errors without a site, those are reported at the call
+    try {
+        return fn->call(args);
+    } catch (Error &e) {
+        if (e.site.line == 0) {
+            e.site = paren;
+        }
+        throw;
+    }
+}
+
+inline Value function(const char *name, size_t params, Code code, const std::shared_ptr<Scope> &closure)
+{
+    return Value(std::shared_ptr<Callable>(std::make_shared<Function>(name, params, code, closure)));
+}
+
+inline Value lox_class(const char *name)
+{
+    return Value(std::make_shared<Class>(name));
+}
+
+// Get the field of an instance. Like the interpreter, getting a property of any
+// other value evaluates to the value itself
+inline Value get_property(const Value &object, const char *name, Site site)
+{
+    if (auto *inst = std::get_if<std::shared_ptr<Instance>>(&object.v)) {
+        auto fnd = (*inst)->fields.find(name);
+        if (fnd == (*inst)->fields.end()) {
+            error(site, std::string("Undefined property '") + name + "'");
+        }
+        return fnd->second;
+    }
+    return object;
+}
+
+// The instance to set a field of, checked before the value is evaluated
+inline Instance &instance_for_set(const Value &object, Site site)
+{
+    if (auto *inst = std::get_if<std::shared_ptr<Instance>>(&object.v)) {
+        return **inst;
+    }
+    error(site, "Only instances have fields");
+}
+
+// Print the value as the interpreter does, note nil is printed without a newline
+inline void print(const Value &v)
+{
+    switch (v.type()) {
+    case Value::NIL:
+        write("nil");
+        return;
+    case Value::BOOL:
+        write(*std::get_if<bool>(&v.v) ? "true" : "false");
+        break;
+    case Value::NUMBER:
+        write(format_number(v.number()));
+        break;
+    case Value::STRING:
+        write(v.string());
+        break;
+    case Value::CALLABLE:
+        write((*std::get_if<std::shared_ptr<Callable>>(&v.v))->to_string());
+        break;
+    case Value::CLASS:
+        write((*std::get_if<std::shared_ptr<Class>>(&v.v))->to_string());
+        break;
+    case Value::INSTANCE:
+        write((*std::get_if<std::shared_ptr<Instance>>(&v.v))->to_string());
+        break;
+    }
+    write("\n");
+}
+}
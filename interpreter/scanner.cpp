@@ -1,9 +1,21 @@
 #include "scanner.h"
 #include <cctype>
 #include <iostream>
-#include "util.h"
-
-Scanner::Scanner(const std::string &source) : source(source) {}
+#include "lex_simd.h"
+#include "number.h"
+
+static_assert(identifier_type("while") == TokenType::WHILE);
+static_assert(identifier_type("fun") == TokenType::FUN);
+static_assert(identifier_type("for") == TokenType::FOR);
+static_assert(identifier_type("this") == TokenType::THIS);
+static_assert(identifier_type("true") == TokenType::TRUE);
+static_assert(identifier_type("fu") == TokenType::IDENTIFIER);
+static_assert(identifier_type("classes") == TokenType::IDENTIFIER);
+
+Scanner::Scanner(std::string_view source, ErrorReporter &errors)
+    : source(source), errors(errors)
+{
+}
 
 const std::vector<Token> &Scanner::scan_tokens()
 {
@@ -18,6 +30,21 @@ const std::vector<Token> &Scanner::scan_tokens()
     return tokens;
 }
 
+Token Scanner::next_token()
+{
+    // Scanning whitespace or comments doesn't produce a token, so keep going
+    // until one is added
+    tokens.clear();
+    while (tokens.empty() && !at_end()) {
+        start = current;
+        scan_token();
+    }
+    if (tokens.empty()) {
+        return Token(TokenType::END_OF_FILE, line);
+    }
+    return std::move(tokens.back());
+}
+
 void Scanner::scan_token()
 {
     char c = advance();
@@ -67,17 +94,10 @@ void Scanner::scan_token()
     case '/':
         // If it's a comment, advance to the next line to skip it
         if (match('/')) {
-            while (peek() != '\n' && !at_end()) {
-                advance();
-            }
+            current = lex_find_line_end(source, current);
         } else if (match('*')) {
             // Skip entire block comments, but do not support nesting
-            while ((peek() != '*' || peek_next() != '/') && !at_end()) {
-                if (peek() == '\n') {
-                    ++line;
-                }
-                advance();
-            }
+            current = lex_find_block_comment_end(source, current, line);
             // Skip the block close
             current += 2;
         } else {
@@ -87,12 +107,15 @@ void Scanner::scan_token()
     case '"':
         scan_string();
         break;
+    case '\n':
+        ++line;
+        // Skip the rest of the whitespace in one go
+        current = lex_skip_whitespace(source, current, line);
+        break;
     case ' ':
     case '\t':
     case '\r':
-        break;
-    case '\n':
-        ++line;
+        current = lex_skip_whitespace(source, current, line);
         break;
     default:
         if (std::isdigit(c)) {
@@ -100,7 +123,7 @@ void Scanner::scan_token()
         } else if (std::isalpha(c) || c == '_') {
             scan_identifier();
         } else {
-            error(line, "Unrecognized character '" + std::string(1, c) + "'");
+            errors.error(line, "Unrecognized character '" + std::string(1, c) + "'");
         }
         break;
     }
@@ -108,7 +131,7 @@ void Scanner::scan_token()
 
 void Scanner::add_token(TokenType type)
 {
-    tokens.push_back(Token(type, source.substr(start, current - start), line));
+    tokens.push_back(Token(type, std::string(source.substr(start, current - start)), line));
 }
 
 char Scanner::advance()
@@ -148,22 +171,17 @@ bool Scanner::at_end() const
 
 void Scanner::scan_string()
 {
-    while (peek() != '"' && !at_end()) {
-        if (peek() == '\n') {
-            ++line;
-        }
-        advance();
-    }
+    current = lex_find_string_end(source, current, line);
 
     if (at_end()) {
-        error(line, "Unterminated string literal");
+        errors.error(line, "Unterminated string literal");
         return;
     }
 
     // Consume the closing "
     advance();
 
-    add_token(TokenType::STRING, source.substr(start + 1, current - start - 2));
+    add_token(TokenType::STRING, std::string(source.substr(start + 1, current - start - 2)));
 }
 
 void Scanner::scan_number()
@@ -180,24 +198,23 @@ void Scanner::scan_number()
         }
     }
 
-    add_token(TokenType::NUMBER, std::stof(source.substr(start, current - start)));
+    add_token(TokenType::NUMBER, parse_number(source.substr(start, current - start)));
 }
 
 void Scanner::scan_identifier()
 {
     // Scan the entire identifier
-    while (std::isalpha(peek()) || std::isdigit(peek()) || peek() == '_') {
-        advance();
-    }
-
-    // Check if it's a reserved word
-    const std::string ident = source.substr(start, current - start);
-    TokenType type = TokenType::IDENTIFIER;
-    auto fnd = reserved_words.find(ident);
-    if (fnd != reserved_words.end()) {
-        type = fnd->second;
+    current = lex_skip_identifier(source, current);
+
+    const auto ident = source.substr(start, current - start);
+    const auto type = identifier_type(ident);
+    add_token(type);
+    if (type == TokenType::IDENTIFIER) {
+        try {
+            tokens.back().symbol = intern(ident);
+        } catch (const SymbolLimitError &e) {
+            errors.error(line, std::string(e.what()) + ", can't add '" + std::string(ident) + "'");
+        }
     }
-
-    add_token(type, ident);
 }
 
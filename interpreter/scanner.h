@@ -1,43 +1,31 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
+#include "error_reporter.h"
 #include "token.h"
 
+// Scans the tokens of a script. The scanner only views the source, which must
+// outlive it, so the script is never copied.
 struct Scanner {
-    std::string source;
+    std::string_view source;
     std::vector<Token> tokens;
+    ErrorReporter &errors;
 
     // The scanner's location in the source
     int start = 0;
     int current = 0;
     int line = 1;
 
-    std::unordered_map<std::string, TokenType> reserved_words = {
-        {"and", TokenType::AND},
-        {"class", TokenType::CLASS},
-        {"else", TokenType::ELSE},
-        {"false", TokenType::FALSE},
-        {"fun", TokenType::FUN},
-        {"for", TokenType::FOR},
-        {"if", TokenType::IF},
-        {"nil", TokenType::NIL},
-        {"or", TokenType::OR},
-        {"print", TokenType::PRINT},
-        {"return", TokenType::RETURN},
-        {"super", TokenType::SUPER},
-        {"this", TokenType::THIS},
-        {"true", TokenType::TRUE},
-        {"var", TokenType::VAR},
-        {"while", TokenType::WHILE},
-    };
-
-    Scanner() = default;
-    Scanner(const std::string &source);
+    Scanner(std::string_view source, ErrorReporter &errors);
 
     const std::vector<Token> &scan_tokens();
 
+    // Scan and return the next token, for producing tokens on demand. Returns
+    // END_OF_FILE once the whole source has been scanned
+    Token next_token();
+
 private:
     void scan_token();
 
@@ -65,9 +53,63 @@ private:
     void scan_identifier();
 };
 
+// Check if the identifier is the keyword, for use in identifier_type
+constexpr TokenType match_keyword(std::string_view ident, std::string_view keyword, TokenType type)
+{
+    return ident == keyword ? type : TokenType::IDENTIFIER;
+}
+
+// Get the keyword token type of the identifier, or IDENTIFIER if it isn't one.
+// Switching on the first character, and the length and second character where
+// keywords share a first character, leaves at most one keyword to compare
+// against the source.
+constexpr TokenType identifier_type(std::string_view ident)
+{
+    switch (ident[0]) {
+    case 'a':
+        return match_keyword(ident, "and", TokenType::AND);
+    case 'c':
+        return match_keyword(ident, "class", TokenType::CLASS);
+    case 'e':
+        return match_keyword(ident, "else", TokenType::ELSE);
+    case 'f':
+        switch (ident.size()) {
+        case 3:
+            return ident[1] == 'u' ? match_keyword(ident, "fun", TokenType::FUN)
+                                   : match_keyword(ident, "for", TokenType::FOR);
+        case 5:
+            return match_keyword(ident, "false", TokenType::FALSE);
+        }
+        break;
+    case 'i':
+        return match_keyword(ident, "if", TokenType::IF);
+    case 'n':
+        return match_keyword(ident, "nil", TokenType::NIL);
+    case 'o':
+        return match_keyword(ident, "or", TokenType::OR);
+    case 'p':
+        return match_keyword(ident, "print", TokenType::PRINT);
+    case 'r':
+        return match_keyword(ident, "return", TokenType::RETURN);
+    case 's':
+        return match_keyword(ident, "super", TokenType::SUPER);
+    case 't':
+        if (ident.size() == 4) {
+            return ident[1] == 'h' ? match_keyword(ident, "this", TokenType::THIS)
+                                   : match_keyword(ident, "true", TokenType::TRUE);
+        }
+        break;
+    case 'v':
+        return match_keyword(ident, "var", TokenType::VAR);
+    case 'w':
+        return match_keyword(ident, "while", TokenType::WHILE);
+    }
+    return TokenType::IDENTIFIER;
+}
+
 template <typename T>
 void Scanner::add_token(TokenType type, const T &literal)
 {
-    tokens.push_back(Token(type, source.substr(start, current - start), literal, line));
+    tokens.push_back(Token(type, std::string(source.substr(start, current - start)), literal, line));
 }
 
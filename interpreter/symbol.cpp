@@ -0,0 +1,82 @@
+#include "symbol.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace {
+
+class SymbolTable {
+    // Deque elements don't move when it grows, so the map can key on views of
+    // the names
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, Symbol> symbols;
+    mutable std::shared_mutex mutex;
+
+public:
+    std::atomic<size_t> limit = size_t(std::numeric_limits<Symbol>::max()) + 1;
+
+    SymbolTable()
+    {
+        intern("");
+    }
+
+    Symbol intern(std::string_view name)
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto fnd = symbols.find(name);
+            if (fnd != symbols.end()) {
+                return fnd->second;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        // Another thread may have added it while we didn't hold the lock
+        auto fnd = symbols.find(name);
+        if (fnd != symbols.end()) {
+            return fnd->second;
+        }
+        if (names.size() >= limit) {
+            throw SymbolLimitError();
+        }
+        const Symbol symbol = names.size();
+        names.emplace_back(name);
+        symbols[names.back()] = symbol;
+        return symbol;
+    }
+
+    const std::string &name(Symbol symbol) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return names[symbol];
+    }
+};
+
+SymbolTable &symbol_table()
+{
+    static SymbolTable table;
+    return table;
+}
+
+}
+
+SymbolLimitError::SymbolLimitError() : std::runtime_error("Too many distinct names") {}
+
+Symbol intern(std::string_view name)
+{
+    return symbol_table().intern(name);
+}
+
+const std::string &symbol_name(Symbol symbol)
+{
+    return symbol_table().name(symbol);
+}
+
+void set_symbol_limit(size_t limit)
+{
+    symbol_table().limit = std::min(limit, size_t(std::numeric_limits<Symbol>::max()) + 1);
+}
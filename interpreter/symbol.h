@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Identifiers are interned in a global symbol table when they're scanned, which
+// gives each distinct name a dense 32-bit ID. Environments, scopes and instance
+// fields are keyed by the symbol, so looking up a name compares integers instead
+// of hashing and comparing strings. Symbol 0 is the empty name.
+//
+// The table is shared by all isolates and only grows, a name stays in it for the
+// life of the process once any script has used it. It holds one entry per
+// distinct name, so running the same scripts again doesn't grow it, but a host
+// compiling many different scripts keeps every name they declared. Such hosts
+// can bound it with set_symbol_limit.
+using Symbol = uint32_t;
+
+// Thrown when a new name is interned but the table is at its limit
+struct SymbolLimitError : std::runtime_error {
+    SymbolLimitError();
+};
+
+// Get the symbol for the name, adding it to the table if it's new. Safe to call
+// from multiple threads.
+Symbol intern(std::string_view name);
+
+// Limit the number of names in the table, including the empty name. Once it's
+// reached, compiling a script with a new name fails with a compile error instead
+// of adding it. The default and the maximum are the number of 32-bit symbols.
+void set_symbol_limit(size_t limit);
+
+// Get the name of the symbol. The reference stays valid for the life of the
+// program.
+const std::string &symbol_name(Symbol symbol);
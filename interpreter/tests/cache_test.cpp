@@ -0,0 +1,143 @@
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include "check.h"
+#include "lox.h"
+#include "program_cache.h"
+
+// The layout of a .loxc file, see program_cache.h
+const size_t header_size = 40;
+const size_t checksum_offset = 32;
+
+// Tags of the nodes written by hand below, from program_cache.cpp
+const char block_tag = 1;
+const char print_tag = 5;
+const char literal_tag = 5;
+const char variable_tag = 8;
+const char nil_tag = 0;
+
+const char *const script = R"(fun fib(n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+class Point {}
+var p = Point();
+p.x = 3;
+{
+    var a = "fib";
+    var b = fib(p.x + 7);
+    print a + " " + b;
+}
+for (var i = 0; i < 3; i = i + 1) {
+    print i * 2;
+}
+)";
+
+std::string u32(uint32_t x)
+{
+    std::string s(4, '\0');
+    for (int i = 0; i < 4; ++i) {
+        s[i] = static_cast<char>(x >> (8 * i));
+    }
+    return s;
+}
+
+std::string u64(uint64_t x)
+{
+    return u32(uint32_t(x)) + u32(uint32_t(x >> 32));
+}
+
+// A file for the payload with a valid header and checksum
+std::string seal(const std::string &payload)
+{
+    return std::string(LOXC_MAGIC, sizeof(LOXC_MAGIC)) + u32(LOXC_VERSION) + u64(LOXC_BUILD_ID) +
+           u64(fnv1a(script)) + u64(std::strlen(script)) + u64(fnv1a(payload)) + payload;
+}
+
+std::shared_ptr<const Program> load(const std::string &data)
+{
+    return deserialize_program(data, fnv1a(script), std::strlen(script));
+}
+
+std::string run(const std::shared_ptr<const Program> &program)
+{
+    auto output = std::make_shared<StringOutputSink>();
+    std::ostringstream errors;
+    Isolate isolate(output, errors);
+    CHECK(isolate.run(program));
+    CHECK_EQ(errors.str(), "");
+    return output->output;
+}
+
+// A block nested depth times around a print statement
+std::string nested_blocks(size_t depth)
+{
+    std::string payload = u32(1);
+    for (size_t i = 0; i < depth; ++i) {
+        payload += block_tag + u32(1);
+    }
+    return payload + print_tag + literal_tag + nil_tag;
+}
+
+// { print a; } with a resolved to the depth, stored as depth + 1
+std::string block_reading_variable(uint32_t depth)
+{
+    const std::string token = std::string(1, char(TokenType::IDENTIFIER)) + u32(1) + "a" + nil_tag + u32(1);
+    return u32(1) + block_tag + u32(1) + print_tag + variable_tag + token + u32(depth + 1);
+}
+
+int main()
+{
+    ErrorReporter errors;
+    const auto compiled = compile(script, errors);
+    CHECK(compiled != nullptr);
+    if (!compiled) {
+        return check_result();
+    }
+    const auto data = serialize_program(*compiled, fnv1a(script), std::strlen(script));
+    const auto expected = run(compiled);
+    CHECK_EQ(expected, "fib 55\n0\n2\n4\n");
+
+    const auto loaded = load(data);
+    CHECK(loaded != nullptr);
+    if (loaded) {
+        CHECK_EQ(run(loaded), expected);
+    }
+
+    // Any change to a byte of the file is caught by the header or the checksum
+    for (size_t i = 0; i < data.size(); ++i) {
+        auto corrupt = data;
+        corrupt[i] = static_cast<char>(corrupt[i] ^ 0x5a);
+        CHECK(load(corrupt) == nullptr);
+    }
+    CHECK(load(data.substr(0, data.size() - 1)) == nullptr);
+    CHECK(load(data + '\0') == nullptr);
+
+    // Corrupt payloads with a valid checksum are rejected by the reader, and
+    // those it accepts must still be well formed enough to load without crashing
+    std::mt19937 rng(1234);
+    for (int i = 0; i < 5000; ++i) {
+        auto payload = data.substr(header_size);
+        for (int n = 1 + rng() % 3; n > 0; --n) {
+            payload[rng() % payload.size()] = static_cast<char>(rng());
+        }
+        load(seal(payload));
+    }
+
+    CHECK(load(seal(nested_blocks(100))) != nullptr);
+    CHECK(load(seal(nested_blocks(LOXC_MAX_NESTING))) == nullptr);
+
+    CHECK(load(seal(block_reading_variable(0))) != nullptr);
+    CHECK(load(seal(block_reading_variable(1))) == nullptr);
+    CHECK(load(seal(block_reading_variable(1000))) == nullptr);
+
+    // A statement which can't be null, here the print's expression
+    CHECK(load(seal(u32(1) + print_tag + '\0')) == nullptr);
+
+    CHECK_EQ(data.substr(checksum_offset, 8), u64(fnv1a(data.substr(header_size))));
+    return check_result();
+}
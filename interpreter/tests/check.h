@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Minimal assertions for the C++ tests of liblox. A failed check is reported and
+// counted, and the test's main returns check_result() so every failure is seen
+inline int check_failures = 0;
+
+inline void check(bool ok, const char *expr, const char *file, int line)
+{
+    if (!ok) {
+        ++check_failures;
+        std::cerr << file << ":" << line << ": Check failed: " << expr << "\n";
+    }
+}
+
+template <typename T, typename U>
+void check_equal(const T &actual,
+                 const U &expected,
+                 const char *expr,
+                 const char *file,
+                 int line)
+{
+    if (!(actual == expected)) {
+        ++check_failures;
+        std::cerr << file << ":" << line << ": Check failed: " << expr << "\n"
+                  << "  Expected: " << expected << "\n"
+                  << "  Got: " << actual << "\n";
+    }
+}
+
+inline int check_result()
+{
+    if (check_failures != 0) {
+        std::cerr << check_failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+#define CHECK(expr) check((expr), #expr, __FILE__, __LINE__)
+
+#define CHECK_EQ(actual, expected) \
+    check_equal((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)
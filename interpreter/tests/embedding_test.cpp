@@ -0,0 +1,79 @@
+#include <any>
+#include <memory>
+#include <sstream>
+#include <string>
+#include "check.h"
+#include "lox.h"
+
+// Runs the source in a fresh isolate with the test natives, returning what it
+// printed and the errors it reported
+struct Run {
+    bool ok;
+    std::string output;
+    std::string errors;
+};
+
+Run run(const std::string &source)
+{
+    auto output = std::make_shared<StringOutputSink>();
+    std::ostringstream errors;
+    Isolate isolate(output, errors);
+    auto &interpreter = isolate.interpreter;
+    interpreter.register_native("scale", [](float x, int n) { return x * n; });
+    interpreter.register_native("twice", [](double x) { return 2 * x; });
+    interpreter.register_native("greet", [](const std::string &name, bool loud) {
+        return std::string(loud ? "HELLO " : "hello ") + name;
+    });
+    interpreter.register_native("is_number",
+                                [](const std::any &val) { return val.type() == typeid(float); });
+    interpreter.register_native("ignore", [](const std::any &) {});
+    const bool ok = isolate.run(source);
+    return Run{ok, output->output, errors.str()};
+}
+
+int main()
+{
+    {
+        const auto r = run("print scale(1.5, 4);\n"
+                           "print twice(0.25);\n"
+                           "print greet(\"lox\", true);\n"
+                           "print greet(\"a\" + \"b\", false);\n"
+                           "print is_number(1);\n"
+                           "print is_number(\"1\");\n"
+                           "print ignore(1);\n"
+                           "print scale;\n");
+        CHECK(r.ok);
+        CHECK_EQ(r.output, "6\n0.5\nHELLO lox\nhello ab\ntrue\nfalse\nnil<fn scale>\n");
+        CHECK_EQ(r.errors, "");
+    }
+    {
+        const auto r = run("print 1;\nscale(1);\nprint 2;\n");
+        CHECK(!r.ok);
+        CHECK_EQ(r.output, "1\n");
+        CHECK_EQ(r.errors, "[line 2] Error  at ')': Expected 2 arguments but got 1\n");
+    }
+    {
+        const auto r = run("greet(\"lox\", 1);\n");
+        CHECK(!r.ok);
+        CHECK_EQ(r.errors,
+                 "[line 1] Error  at ')': Invalid argument 2 to greet: Expected bool but got "
+                 "float\n");
+    }
+    {
+        const auto r = run("scale(nil, 2);\n");
+        CHECK(!r.ok);
+        CHECK_EQ(r.errors,
+                 "[line 1] Error  at ')': Invalid argument 1 to scale: Expected float but got "
+                 "nil\n");
+    }
+    {
+        // Errors in a block are reported and the script continues after it
+        const auto r = run("{\n    print twice(\"x\");\n}\nprint twice(2);\n");
+        CHECK(!r.ok);
+        CHECK_EQ(r.output, "4\n");
+        CHECK_EQ(r.errors,
+                 "[line 2] Error  at ')': Invalid argument 1 to twice: Expected float but got "
+                 "string\n");
+    }
+    return check_result();
+}
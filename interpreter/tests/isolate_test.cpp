@@ -0,0 +1,96 @@
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "lox.h"
+
+// Each isolate runs the same program, which differs only in the id its native
+// returns. The functions are deferred, so the isolates race to compile their
+// bodies in the shared program, and sum gets hot enough to be compiled by the JIT
+const char *const script = R"(class Counter {}
+fun make(start) {
+    var c = Counter();
+    c.value = start;
+    fun next() {
+        c.value = c.value + 1;
+        return c.value;
+    }
+    return next;
+}
+fun sum(n) {
+    var total = 0;
+    for (var i = 0; i < n; i = i + 1) {
+        total = total + i;
+    }
+    return total;
+}
+var id = isolate_id();
+var next = make(id * 100);
+next();
+print next();
+var check = 0;
+for (var i = 0; i < 300; i = i + 1) {
+    check = check + sum(10);
+}
+print check;
+{
+    if (id == 3) {
+        print "error " + -"x";
+    }
+}
+print "done " + id;
+)";
+
+struct TestIsolate {
+    std::shared_ptr<StringOutputSink> output = std::make_shared<StringOutputSink>();
+    std::ostringstream errors;
+    std::shared_ptr<Isolate> isolate = std::make_shared<Isolate>(output, errors);
+};
+
+int main()
+{
+    std::ostringstream compile_errors;
+    ErrorReporter reporter(compile_errors);
+    const auto program = compile(script, reporter, nullptr, true);
+    CHECK(program != nullptr);
+    CHECK_EQ(compile_errors.str(), "");
+    if (!program) {
+        return check_result();
+    }
+
+    const int n_isolates = 8;
+    std::vector<std::unique_ptr<TestIsolate>> isolates;
+    for (int i = 0; i < n_isolates; ++i) {
+        isolates.push_back(std::make_unique<TestIsolate>());
+        isolates.back()->isolate->interpreter.register_native("isolate_id", [i]() { return i; });
+    }
+
+    // Each isolate runs the program twice, its globals are defined again by the
+    // second run
+    for (int run = 0; run < 2; ++run) {
+        IsolatePool pool(4);
+        std::vector<std::future<bool>> results;
+        for (auto &i : isolates) {
+            results.push_back(pool.submit(i->isolate, program));
+        }
+        for (int i = 0; i < n_isolates; ++i) {
+            CHECK_EQ(results[i].get(), i != 3);
+        }
+    }
+
+    for (int i = 0; i < n_isolates; ++i) {
+        const auto &t = *isolates[i];
+        const auto expected = std::to_string(i * 100 + 2) + "\n13500\ndone " + std::to_string(i) + "\n";
+        CHECK_EQ(t.output->output, expected + expected);
+        if (i == 3) {
+            const std::string error = "[line 29] Error  at '-': Expected one of {float} but got string\n";
+            CHECK_EQ(t.errors.str(), error + error);
+            CHECK(t.isolate->interpreter.errors.had_error);
+        } else {
+            CHECK_EQ(t.errors.str(), "");
+            CHECK(!t.isolate->interpreter.errors.had_error);
+        }
+    }
+    return check_result();
+}
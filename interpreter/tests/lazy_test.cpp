@@ -0,0 +1,95 @@
+#include <memory>
+#include <sstream>
+#include <string>
+#include "check.h"
+#include "lox.h"
+
+// Compiles the source with deferred function bodies and runs it in a fresh
+// isolate, returning what it printed and the errors it reported
+struct Run {
+    bool ok;
+    std::string output;
+    std::string errors;
+};
+
+Run run(const std::string &source)
+{
+    auto output = std::make_shared<StringOutputSink>();
+    std::ostringstream errors;
+    Isolate isolate(output, errors);
+    auto program = compile(source, isolate.interpreter.errors, nullptr, true);
+    if (!program) {
+        return Run{false, output->output, errors.str()};
+    }
+    const bool ok = isolate.run(program);
+    return Run{ok, output->output, errors.str()};
+}
+
+int main()
+{
+    {
+        // A body that's never called isn't compiled, so its errors aren't reported
+        const auto r = run("fun broken() {\n"
+                           "    print 1 +;\n"
+                           "}\n"
+                           "print \"ok\";\n");
+        CHECK(r.ok);
+        CHECK_EQ(r.output, "ok\n");
+        CHECK_EQ(r.errors, "");
+    }
+    {
+        // The syntax error is reported at its line in the script when the function
+        // is first called, and the call fails at the function's name
+        const auto r = run("fun fine(x) {\n"
+                           "    return x * 2;\n"
+                           "}\n"
+                           "print fine(2);\n"
+                           "fun broken() {\n"
+                           "    var a = 1;\n"
+                           "    print a +;\n"
+                           "}\n"
+                           "print \"before\";\n"
+                           "broken();\n"
+                           "print \"after\";\n");
+        CHECK(!r.ok);
+        CHECK_EQ(r.output, "4\nbefore\n");
+        CHECK_EQ(r.errors,
+                 "[line 7] Error  at ';': Expected expression\n"
+                 "interpreter error: ParseError\n"
+                 "[line 5] Error  at 'broken': Can't call broken, its body failed to compile\n");
+    }
+    {
+        // The body is only compiled once, later calls fail without reporting the
+        // syntax error again
+        const auto r = run("fun broken() {\n"
+                           "    print (1;\n"
+                           "}\n"
+                           "{\n"
+                           "    broken();\n"
+                           "}\n"
+                           "{\n"
+                           "    broken();\n"
+                           "}\n"
+                           "print \"done\";\n");
+        CHECK(!r.ok);
+        CHECK_EQ(r.output, "done\n");
+        CHECK_EQ(r.errors,
+                 "[line 2] Error  at ';': Expected ')' after expression\n"
+                 "interpreter error: ParseError\n"
+                 "[line 1] Error  at 'broken': Can't call broken, its body failed to compile\n"
+                 "[line 1] Error  at 'broken': Can't call broken, its body failed to compile\n");
+    }
+    {
+        // A body that only fails to resolve is reported the same way
+        const auto r = run("fun broken() {\n"
+                           "    var a = a;\n"
+                           "}\n"
+                           "broken();\n");
+        CHECK(!r.ok);
+        CHECK_EQ(r.output, "");
+        CHECK(r.errors.find("[line 2]") == 0);
+        CHECK(r.errors.find("[line 1] Error  at 'broken': Can't call broken, its body failed to "
+                            "compile\n") != std::string::npos);
+    }
+    return check_result();
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "check.h"
+#include "lex_simd.h"
+#include "scanner.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LOX_CHECK_CPU
+#endif
+
+// Compares each vectorized function with its scalar version at every position of
+// the source. Each starts with a line count of 1, which they must both advance by
+// the same newlines
+void check_positions(std::string_view src)
+{
+    for (size_t pos = 0; pos <= src.size(); ++pos) {
+        int line = 1;
+        int scalar_line = 1;
+        CHECK_EQ(lex_skip_whitespace(src, pos, line),
+                 lex_skip_whitespace_scalar(src, pos, scalar_line));
+        CHECK_EQ(line, scalar_line);
+
+        CHECK_EQ(lex_find_line_end(src, pos), lex_find_line_end_scalar(src, pos));
+
+        line = scalar_line = 1;
+        CHECK_EQ(lex_find_block_comment_end(src, pos, line),
+                 lex_find_block_comment_end_scalar(src, pos, scalar_line));
+        CHECK_EQ(line, scalar_line);
+
+        line = scalar_line = 1;
+        CHECK_EQ(lex_find_string_end(src, pos, line),
+                 lex_find_string_end_scalar(src, pos, scalar_line));
+        CHECK_EQ(line, scalar_line);
+
+        CHECK_EQ(lex_skip_identifier(src, pos), lex_skip_identifier_scalar(src, pos));
+    }
+}
+
+// A run of n copies of fill, ended by the terminator and padded past the next
+// 32 byte block, so the run ends in every lane of both block widths
+std::string run_of(char fill, size_t n, std::string_view terminator)
+{
+    return std::string(n, fill) + std::string(terminator) + std::string(40, '.');
+}
+
+struct Scanned {
+    std::vector<std::string> lexemes;
+    std::vector<int> lines;
+    std::string errors;
+};
+
+Scanned scan(std::string_view source)
+{
+    std::ostringstream errors;
+    ErrorReporter reporter(errors);
+    Scanner scanner(source, reporter);
+    Scanned scanned;
+    for (const auto &t : scanner.scan_tokens()) {
+        scanned.lexemes.push_back(t.lexeme);
+        scanned.lines.push_back(t.line);
+    }
+    scanned.errors = errors.str();
+    return scanned;
+}
+
+int main()
+{
+#ifdef LOX_CHECK_CPU
+    // The AVX2 build of this test can be configured on a machine that can't
+    // run it
+    if (LexBlock::width == 32 && !__builtin_cpu_supports("avx2")) {
+        std::cout << "Skipped, the CPU doesn't support AVX2\n";
+        return check_result();
+    }
+#endif
+
+    // Runs of each kind that end at every offset across two blocks of either
+    // width, on bytes at the edges of the ranges the blocks classify, including
+    // the non-ASCII bytes which are negative when compared as signed chars
+    const std::vector<char> fills = {' ',  '\n', '\t', 'a',  'z',  'A',    'Z',    '0',
+                                     '9',  '_',  '*',  '/',  '"',  '@',    '[',    '`',
+                                     '{',  ':',  '\r', '\x7f', '\x80', '\xc3', '\xe1', '\xff'};
+    const std::vector<std::string_view> terminators = {"",  "\n", "\"", "*/", "*",
+                                                       "/", "x",  "\xc3\xa9", "\xff"};
+    for (const char fill : fills) {
+        for (size_t n = 0; n <= 66; ++n) {
+            for (const auto terminator : terminators) {
+                check_positions(run_of(fill, n, terminator));
+            }
+        }
+    }
+
+    // Random mixtures of the same bytes, so every lane of a block sees each of them
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<size_t> pick(0, fills.size() - 1);
+    std::uniform_int_distribution<size_t> length(0, 100);
+    for (int i = 0; i < 2000; ++i) {
+        std::string src(length(rng), ' ');
+        for (auto &c : src) {
+            c = fills[pick(rng)];
+        }
+        check_positions(src);
+    }
+
+    // Tokens, strings and comments crossing the block boundaries are scanned the
+    // same wherever they start
+    for (size_t pad = 1; pad <= 33; ++pad) {
+        const std::string text(pad, 'x');
+        const std::string string = "\"" + text + "\xc3\xa9\n\xe2\x82\xac\"";
+        const std::string source = std::string(pad, ' ') + "var " + text + "_long_identifier9 = " +
+                                   string + "; // " + text + "\xff\n/* " + text +
+                                   "\n*\xc3\xa9* */ print " + text + ";";
+        const auto scanned = scan(source);
+        CHECK_EQ(scanned.errors, "");
+        const std::vector<std::string> lexemes = {"var",
+                                                  text + "_long_identifier9",
+                                                  "=",
+                                                  string,
+                                                  ";",
+                                                  "print",
+                                                  text,
+                                                  ";",
+                                                  ""};
+        const std::vector<int> lines = {1, 1, 1, 2, 2, 4, 4, 4, 4};
+        CHECK(scanned.lexemes == lexemes);
+        CHECK(scanned.lines == lines);
+    }
+
+    // A string that's never closed runs to the end of the source
+    for (size_t n = 0; n <= 66; ++n) {
+        const auto scanned = scan("\"" + std::string(n, '\xc3'));
+        CHECK_EQ(scanned.errors, "[line 1] Error : Unterminated string literal\n");
+    }
+    return check_result();
+}
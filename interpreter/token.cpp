@@ -1,4 +1,5 @@
 #include "token.h"
+#include "number.h"
 
 Token::Token(TokenType type, int line) : type(type), line(line) {}
 
@@ -104,7 +105,7 @@ std::ostream &operator<<(std::ostream &os, const Token &t)
     os << "[Token]: " << t.type << " " << t.lexeme << " ";
     if (t.literal.has_value()) {
         if (t.literal.type() == typeid(float)) {
-            os << std::any_cast<float>(t.literal);
+            os << format_number(std::any_cast<float>(t.literal));
         } else if (t.literal.type() == typeid(std::string)) {
             os << std::any_cast<std::string>(t.literal);
         } else {
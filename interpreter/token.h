@@ -3,6 +3,7 @@
 #include <any>
 #include <ostream>
 #include <string>
+#include "symbol.h"
 
 enum class TokenType {
     // Single-character tokens.
@@ -59,6 +60,8 @@ struct Token {
     std::string lexeme;
     std::any literal;
     int line;
+    // The interned lexeme of identifiers, 0 for other tokens
+    Symbol symbol = 0;
 
     Token() = default;
 
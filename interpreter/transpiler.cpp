@@ -0,0 +1,671 @@
+#include "transpiler.h"
+#include <cstdio>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+// Finds whether a function is declared in the statements, in which case their
+// scope is captured by the function's closure
+struct FunctionFinder : Stmt::Visitor {
+    bool found = false;
+
+    void visit(const Block &b) override
+    {
+        find(b.statements);
+    }
+
+    void visit(const Expression &) override {}
+
+    void visit(const Class &) override {}
+
+    void visit(const If &f) override
+    {
+        f.then_branch->accept(*this);
+        if (f.else_branch) {
+            f.else_branch->accept(*this);
+        }
+    }
+
+    void visit(const Print &) override {}
+
+    void visit(const Var &) override {}
+
+    void visit(const While &w) override
+    {
+        w.body->accept(*this);
+    }
+
+    void visit(const Function &) override
+    {
+        found = true;
+    }
+
+    void visit(const Return &) override {}
+
+    template <typename Statements>
+    void find(const Statements &statements)
+    {
+        for (const auto &s : statements) {
+            s->accept(*this);
+        }
+    }
+};
+
+template <typename Statements>
+bool declares_function(const Statements &statements)
+{
+    FunctionFinder finder;
+    finder.find(statements);
+    return finder.found;
+}
+
+// Quote the string as a C++ string literal
+std::string quote(const std::string &s)
+{
+    std::string quoted = "\"";
+    for (const char c : s) {
+        const auto u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (c == '\n') {
+            quoted += "\\n";
+        } else if (u < 0x20 || u >= 0x7f) {
+            // Octal escapes are at most 3 digits, unlike hex ones which would
+            // swallow any hex digits following them
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\%03o", u);
+            quoted += buf;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+class Transpiler : Expr::Visitor, Stmt::Visitor {
+public:
+    Transpiler(const Program &program) : program(program) {}
+
+    std::string transpile()
+    {
+        functions.push_back(FunctionState{});
+        out = &main_code;
+        indent = 1;
+        statement_list(program.statements, false);
+
+        std::string source = "// Generated by loxc, see transpiler.h\n";
+        source += "#include \"lox_runtime.h\"\n\nnamespace {\n";
+        for (const auto &g : globals) {
+            source += "loxrt::Global g_" + g + ";\n";
+        }
+        source += constants;
+        source += "\n" + declarations + definitions + "}\n\n";
+        source += "extern \"C\" int lox_main()\n{\n";
+        for (const auto &g : globals) {
+            source += "    loxrt::define_native(g_" + g + ", " + quote(g) + ");\n";
+        }
+        source += main_code;
+        source += "    loxrt::flush();\n    return loxrt::had_error ? 1 : 0;\n}\n\n";
+        source += "#ifndef LOX_NO_MAIN\nint main()\n{\n    return lox_main();\n}\n#endif\n";
+        return source;
+    }
+
+    void visit(const Grouping &g) override
+    {
+        result = expr(*g.expr);
+    }
+
+    void visit(const Literal &l) override
+    {
+        if (l.value.type() == typeid(float)) {
+            // Hex floats are exact
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "%a", static_cast<double>(std::any_cast<float>(l.value)));
+            result = {std::string("loxrt::Value(") + buf + "f)", true};
+        } else if (l.value.type() == typeid(std::string)) {
+            // Strings are constructed once, values share them
+            const auto name = "k" + std::to_string(strings++);
+            constants += "const loxrt::Value " + name + "(std::string(" +
+                         quote(std::any_cast<const std::string &>(l.value)) + "));\n";
+            result = {name, true};
+        } else if (l.value.type() == typeid(bool)) {
+            result = {std::any_cast<bool>(l.value) ? "loxrt::Value(true)" : "loxrt::Value(false)",
+                      true};
+        } else {
+            result = {"loxrt::Value()", true};
+        }
+    }
+
+    void visit(const Unary &u) override
+    {
+        const auto right = expr(*u.expr);
+        if (u.op.type == TokenType::MINUS) {
+            result = {"loxrt::negate(" + right.code + ", " + site(u.op) + ")", false};
+        } else {
+            result = {"loxrt::logical_not(" + right.code + ")", false};
+        }
+    }
+
+    void visit(const Binary &b) override
+    {
+        auto left = expr(*b.left);
+        // The left operand is evaluated first, so it's kept in a temporary if
+        // evaluating the right one could change it or throw
+        if (!trivial(*b.right)) {
+            left = materialize(left);
+        }
+        const auto right = expr(*b.right);
+        const auto operands = left.code + ", " + right.code;
+        switch (b.op.type) {
+        case TokenType::EQUAL_EQUAL:
+            result = {"loxrt::equal(" + operands + ")", false};
+            return;
+        case TokenType::BANG_EQUAL:
+            result = {"loxrt::not_equal(" + operands + ")", false};
+            return;
+        case TokenType::PLUS:
+            result = {"loxrt::add(", false};
+            break;
+        case TokenType::MINUS:
+            result = {"loxrt::subtract(", false};
+            break;
+        case TokenType::STAR:
+            result = {"loxrt::multiply(", false};
+            break;
+        case TokenType::SLASH:
+            result = {"loxrt::divide(", false};
+            break;
+        case TokenType::LESS:
+            result = {"loxrt::less(", false};
+            break;
+        case TokenType::LESS_EQUAL:
+            result = {"loxrt::less_equal(", false};
+            break;
+        case TokenType::GREATER:
+            result = {"loxrt::greater(", false};
+            break;
+        case TokenType::GREATER_EQUAL:
+            result = {"loxrt::greater_equal(", false};
+            break;
+        default:
+            // The interpreter evaluates unknown operators to nil
+            result = {"loxrt::Value()", true};
+            return;
+        }
+        result.code += operands + ", " + site(b.op) + ")";
+    }
+
+    void visit(const Call &c) override
+    {
+        const auto callee = materialize(expr(*c.callee));
+        if (c.args.empty()) {
+            result = {"loxrt::call(" + callee.code + ", nullptr, 0, " + site(c.paren) + ")", false};
+            return;
+        }
+        // The elements of a braced list are evaluated in order, so only arguments
+        // followed by ones with side effects need a temporary
+        std::string args;
+        for (size_t i = 0; i < c.args.size(); ++i) {
+            auto arg = expr(*c.args[i]);
+            for (size_t j = i + 1; j < c.args.size(); ++j) {
+                if (!trivial(*c.args[j])) {
+                    arg = materialize(arg);
+                    break;
+                }
+            }
+            args += (i ? ", " : "") + arg.code;
+        }
+        const auto name = local("a");
+        line("loxrt::Value " + name + "[] = {" + args + "};");
+        result = {"loxrt::call(" + callee.code + ", " + name + ", " + std::to_string(c.args.size()) +
+                      ", " + site(c.paren) + ")",
+                  false};
+    }
+
+    void visit(const Logical &l) override
+    {
+        const auto left = expr(*l.left);
+        const auto name = local("t");
+        line("loxrt::Value " + name + " = " + left.code + ";");
+        if (l.op.type == TokenType::OR) {
+            line("if (!loxrt::truthy(" + name + ")) {");
+        } else {
+            line("if (loxrt::truthy(" + name + ")) {");
+        }
+        ++indent;
+        const auto right = expr(*l.right);
+        line(name + " = " + right.code + ";");
+        --indent;
+        line("}");
+        result = {name, true};
+    }
+
+    void visit(const Variable &v) override
+    {
+        auto fnd = program.locals.find(&v);
+        if (fnd != program.locals.end()) {
+            result = {variable(fnd->second, v.name), false};
+        } else {
+            result = {"loxrt::get(" + global(v.name) + ", " + site(v.name) + ")", false};
+        }
+    }
+
+    void visit(const Assign &a) override
+    {
+        const auto value = expr(*a.value);
+        auto fnd = program.locals.find(&a);
+        if (fnd != program.locals.end()) {
+            const auto var = variable(fnd->second, a.name);
+            line(var + " = " + value.code + ";");
+            result = {var, false};
+        } else {
+            const auto var = global(a.name);
+            line("loxrt::assign(" + var + ", " + value.code + ", " + site(a.name) + ");");
+            result = {var + ".value", false};
+        }
+    }
+
+    void visit(const Get &g) override
+    {
+        const auto object = expr(*g.object);
+        result = {"loxrt::get_property(" + object.code + ", " + quote(g.name.lexeme) + ", " +
+                      site(g.name) + ")",
+                  false};
+    }
+
+    void visit(const Set &s) override
+    {
+        const auto object = materialize(expr(*s.object));
+        const auto instance = local("i");
+        line("auto &" + instance + " = loxrt::instance_for_set(" + object.code + ", " +
+             site(s.name) + ");");
+        const auto value = materialize(expr(*s.value));
+        line(instance + ".fields[" + quote(s.name.lexeme) + "] = " + value.code + ";");
+        result = value;
+    }
+
+    void visit(const Block &b) override
+    {
+        statement_list(b.statements, true);
+    }
+
+    void visit(const Expression &e) override
+    {
+        const auto value = expr(*e.expr);
+        // Assignments are statements already, their result isn't needed
+        const bool assignment =
+            dynamic_cast<const Assign *>(e.expr.get()) || dynamic_cast<const Set *>(e.expr.get());
+        if (!value.stable && !assignment) {
+            line("(void)" + value.code + ";");
+        }
+    }
+
+    void visit(const If &f) override
+    {
+        const auto condition = expr(*f.condition);
+        line("if (loxrt::truthy(" + condition.code + ")) {");
+        branch(*f.then_branch);
+        if (f.else_branch) {
+            line("} else {");
+            branch(*f.else_branch);
+        }
+        line("}");
+    }
+
+    void visit(const While &w) override
+    {
+        // The condition is evaluated in the loop, so any statements it needs are
+        // generated there
+        std::string code;
+        auto *prev = out;
+        out = &code;
+        ++indent;
+        const auto condition = expr(*w.condition);
+        --indent;
+        out = prev;
+
+        if (code.empty()) {
+            line("while (loxrt::truthy(" + condition.code + ")) {");
+        } else {
+            line("while (true) {");
+            *out += code;
+            ++indent;
+            line("if (!loxrt::truthy(" + condition.code + ")) {");
+            line("    break;");
+            line("}");
+            --indent;
+        }
+        branch(*w.body);
+        line("}");
+    }
+
+    void visit(const Print &p) override
+    {
+        line("loxrt::print(" + expr(*p.expr).code + ");");
+    }
+
+    void visit(const Var &v) override
+    {
+        const auto value = v.initializer ? expr(*v.initializer).code : "loxrt::Value()";
+        define(v.token, value);
+    }
+
+    void visit(const Function &f) override
+    {
+        // As in the resolver, a local function is declared before its body so
+        // the body can call it. Globals are looked up when they're used
+        const auto var = scopes.empty() ? global(f.name) : declare(f.name);
+        const auto name = function(f);
+        // The scope the function is declared in is on the heap, see statement_list
+        const auto closure = scopes.empty() ? "nullptr" : scopes.back().heap;
+        const auto value = "loxrt::function(" + quote(f.name.lexeme) + ", " +
+                           std::to_string(f.params.size()) + ", " + name + ", " + closure + ")";
+        if (scopes.empty()) {
+            line("loxrt::define(" + var + ", " + value + ");");
+        } else {
+            line(var + " = " + value + ";");
+        }
+    }
+
+    void visit(const Return &r) override
+    {
+        const auto value = r.value ? expr(*r.value).code : "loxrt::Value()";
+        line("return " + value + ";");
+    }
+
+    void visit(const Class &c) override
+    {
+        // Like the interpreter, the methods of the class are ignored
+        define(c.name, "loxrt::lox_class(" + quote(c.name.lexeme) + ")");
+    }
+
+private:
+    // C++ code evaluating an expression. Stable results are constants or
+    // temporaries which nothing evaluated later can change
+    struct Result {
+        std::string code;
+        bool stable = false;
+    };
+
+    struct Variable {
+        // The C++ local holding the variable, or its slot in a heap scope
+        std::string local;
+        size_t slot = 0;
+    };
+
+    // A local scope of the Lox program, the same as the interpreter's
+    // environments and the resolver's scopes
+    struct Scope {
+        // Set if the scope is on the heap, the C++ local pointing to it
+        std::string heap;
+        // The number of heap scopes enclosing this one
+        size_t heap_depth = 0;
+        // The index of the C++ function the scope is in
+        size_t function = 0;
+        std::unordered_map<Symbol, Variable> variables;
+        size_t slots = 0;
+        // Where the code allocating a heap scope is inserted, once its number of
+        // slots is known
+        size_t start = 0;
+        size_t indent = 0;
+    };
+
+    // The C++ function being generated for a Lox function, or lox_main
+    struct FunctionState {
+        // The heap depth of the innermost heap scope when the function was
+        // declared, which is the closure the function is called with
+        size_t closure_depth = 0;
+        size_t locals = 0;
+    };
+
+    const Program &program;
+    std::set<std::string> globals;
+    std::string constants;
+    size_t strings = 0;
+    std::string declarations;
+    std::string definitions;
+    size_t function_count = 0;
+    std::string main_code;
+    std::string *out = nullptr;
+    size_t indent = 0;
+    std::vector<Scope> scopes;
+    std::vector<FunctionState> functions;
+    Result result;
+
+    void line(const std::string &code)
+    {
+        out->append(4 * indent, ' ');
+        *out += code;
+        *out += '\n';
+    }
+
+    Result expr(const Expr &e)
+    {
+        e.accept(*this);
+        return result;
+    }
+
+    // Whether evaluating the expression can't throw or change any variable
+    bool trivial(const Expr &e) const
+    {
+        if (const auto *g = dynamic_cast<const Grouping *>(&e)) {
+            return trivial(*g->expr);
+        }
+        if (dynamic_cast<const Literal *>(&e)) {
+            return true;
+        }
+        return dynamic_cast<const ::Variable *>(&e) && program.locals.count(&e);
+    }
+
+    // Evaluate the result into a temporary now, if it isn't stable already
+    Result materialize(const Result &r)
+    {
+        if (r.stable) {
+            return r;
+        }
+        const auto name = local("t");
+        line("loxrt::Value " + name + " = " + r.code + ";");
+        return {name, true};
+    }
+
+    std::string local(const char *prefix)
+    {
+        return prefix + std::to_string(functions.back().locals++);
+    }
+
+    std::string site(const Token &t) const
+    {
+        return "loxrt::Site{" + std::to_string(t.line) + ", " + quote(t.lexeme) + "}";
+    }
+
+    std::string global(const Token &name)
+    {
+        globals.insert(name.lexeme);
+        return "g_" + name.lexeme;
+    }
+
+    // The C++ lvalue of the local variable resolved to the scope at depth
+    std::string variable(size_t depth, const Token &name) const
+    {
+        const auto &scope = scopes[scopes.size() - 1 - depth];
+        auto fnd = scope.variables.find(name.symbol);
+        if (fnd == scope.variables.end()) {
+            throw std::logic_error("Unresolved variable " + name.lexeme);
+        }
+        if (scope.heap.empty()) {
+            return fnd->second.local;
+        }
+        const auto slot = "->slots[" + std::to_string(fnd->second.slot) + "]";
+        if (scope.function + 1 == functions.size()) {
+            return scope.heap + slot;
+        }
+        // A variable of an enclosing function is reached through the closure
+        std::string code = "closure";
+        for (size_t i = scope.heap_depth; i < functions.back().closure_depth; ++i) {
+            code += "->parent";
+        }
+        return code + slot;
+    }
+
+    // Define the variable in the current scope, or as a global at the top level
+    void define(const Token &name, const std::string &value)
+    {
+        if (scopes.empty()) {
+            line("loxrt::define(" + global(name) + ", " + value + ");");
+            return;
+        }
+        auto &scope = scopes.back();
+        if (!scope.heap.empty()) {
+            line(declare(name) + " = " + value + ";");
+        } else {
+            const auto var = local("v");
+            line("loxrt::Value " + var + " = " + value + ";");
+            scope.variables[name.symbol] = Variable{var};
+        }
+    }
+
+    // Add the variable to the current scope without a value, returns its C++
+    // lvalue
+    std::string declare(const Token &name)
+    {
+        auto &scope = scopes.back();
+        if (!scope.heap.empty()) {
+            const auto slot = scope.slots++;
+            scope.variables[name.symbol] = Variable{"", slot};
+            return scope.heap + "->slots[" + std::to_string(slot) + "]";
+        }
+        const auto var = local("v");
+        line("loxrt::Value " + var + ";");
+        scope.variables[name.symbol] = Variable{var};
+        return var;
+    }
+
+    // The heap scope a new heap scope is nested in, or nullptr at the top level
+    std::string heap_parent() const
+    {
+        for (auto s = scopes.rbegin(); s != scopes.rend(); ++s) {
+            if (!s->heap.empty()) {
+                return s->function + 1 == functions.size() ? s->heap : "closure";
+            }
+        }
+        return functions.size() > 1 ? "closure" : "nullptr";
+    }
+
+    void begin_scope(bool heap)
+    {
+        Scope scope;
+        scope.function = functions.size() - 1;
+        for (auto s = scopes.rbegin(); s != scopes.rend(); ++s) {
+            if (!s->heap.empty()) {
+                scope.heap_depth = s->heap_depth + 1;
+                break;
+            }
+        }
+        if (heap) {
+            scope.heap = local("e");
+            scope.start = out->size();
+            scope.indent = indent;
+        }
+        scopes.push_back(scope);
+    }
+
+    // The interpreter runs each statement list with Interpreter::evaluate, which
+    // reports a runtime error and skips the rest of the list
+    template <typename Statements>
+    void statement_list(const Statements &statements, bool scope)
+    {
+        line("try {");
+        ++indent;
+        if (scope) {
+            begin_scope(declares_function(statements));
+        }
+        for (const auto &s : statements) {
+            s->accept(*this);
+        }
+        if (scope) {
+            close_scope();
+        }
+        --indent;
+        line("} catch (const loxrt::Error &e) {");
+        line("    loxrt::report(e);");
+        line("}");
+    }
+
+    // Pop the scope, allocating it at its start if it's on the heap
+    void close_scope()
+    {
+        const auto scope = std::move(scopes.back());
+        scopes.pop_back();
+        if (scope.heap.empty()) {
+            return;
+        }
+        std::string alloc(4 * scope.indent, ' ');
+        alloc += "auto " + scope.heap + " = std::make_shared<loxrt::Scope>(" + heap_parent() +
+                 ", " + std::to_string(scope.slots) + ");\n";
+        out->insert(scope.start, alloc);
+    }
+
+    // The branches of ifs and bodies of whiles are run as statement lists of
+    // their own, blocks are already
+    void branch(const Stmt &s)
+    {
+        ++indent;
+        if (dynamic_cast<const Block *>(&s)) {
+            s.accept(*this);
+        } else {
+            statement_list(std::vector<const Stmt *>{&s}, false);
+        }
+        --indent;
+    }
+
+    // Generate the C++ function for the Lox function, returns its name
+    std::string function(const Function &f)
+    {
+        const auto name = "f" + std::to_string(function_count++) + "_" + f.name.lexeme;
+        const auto signature =
+            "loxrt::Value " + name +
+            "([[maybe_unused]] const std::shared_ptr<loxrt::Scope> &closure, "
+            "[[maybe_unused]] loxrt::Value *args)";
+        declarations += signature + ";\n";
+
+        FunctionState state;
+        for (auto s = scopes.rbegin(); s != scopes.rend(); ++s) {
+            if (!s->heap.empty()) {
+                state.closure_depth = s->heap_depth;
+                break;
+            }
+        }
+        std::string code;
+        auto *prev_out = out;
+        const auto prev_indent = indent;
+        out = &code;
+        indent = 1;
+        functions.push_back(state);
+
+        // As in LoxFunction::call, the parameters are in a scope of their own
+        // enclosing the body's
+        begin_scope(!f.params.empty() && declares_function(std::vector<const Stmt *>{f.body.get()}));
+        for (size_t i = 0; i < f.params.size(); ++i) {
+            define(f.params[i], "std::move(args[" + std::to_string(i) + "])");
+        }
+        f.body->accept(*this);
+        close_scope();
+        line("return loxrt::Value();");
+
+        functions.pop_back();
+        out = prev_out;
+        indent = prev_indent;
+        definitions += "\n" + signature + "\n{\n" + code + "}\n";
+        return name;
+    }
+};
+}
+
+std::string transpile(const Program &program)
+{
+    Transpiler transpiler(program);
+    return transpiler.transpile();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include "program.h"
+
+// Translate the resolved program to C++ source using the runtime in
+// runtime/lox_runtime.h. The source defines `extern "C" int lox_main()`, which
+// runs the program and returns 1 if there were runtime errors, and a main calling
+// it unless LOX_NO_MAIN is defined, so it can be built into an executable or a
+// shared object.
+//
+// The compiled program behaves as the interpreter running it: each statement
+// list stops at a runtime error, which is reported and execution continues after
+// the list, operands are evaluated left to right and globals are looked up when
+// they're used. Local variables are resolved to C++ locals at compile time, only
+// the scopes which declare functions are allocated on the heap for the closures
+// to capture.
+std::string transpile(const Program &program);
@@ -0,0 +1,37 @@
+#include "type_feedback.h"
+#include "lox_callable.h"
+
+void TypeFeedback::record(const Binary &b, const std::any &left, const std::any &right)
+{
+    const bool floats = left.type() == typeid(float) && right.type() == typeid(float);
+    sites[&b].types |= floats ? FLOAT : OTHER;
+}
+
+void TypeFeedback::record(const Call &c, const std::any &callee)
+{
+    const void *target = nullptr;
+    if (const auto *fcn = std::any_cast<std::shared_ptr<LoxCallable>>(&callee)) {
+        target = fcn->get();
+    }
+    auto &site = sites[&c];
+    if (!target || (site.target && site.target != target)) {
+        site.polymorphic = true;
+    }
+    site.target = target;
+}
+
+bool TypeFeedback::only_floats(const Binary &b) const
+{
+    auto fnd = sites.find(&b);
+    return fnd != sites.end() && fnd->second.types == FLOAT;
+}
+
+const void *TypeFeedback::target(const Call &c) const
+{
+    auto fnd = sites.find(&c);
+    if (fnd == sites.end() || fnd->second.polymorphic) {
+        return nullptr;
+    }
+    return fnd->second.target;
+}
+
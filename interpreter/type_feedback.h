@@ -0,0 +1,35 @@
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <unordered_map>
+#include "expr.h"
+
+// The types seen by the binary and call expressions of a function while it's
+// interpreted, which the JIT speculates will stay the same when it compiles
+// the function
+struct TypeFeedback {
+    enum Types : uint8_t { FLOAT = 1, OTHER = 2 };
+
+    struct Site {
+        // The types of the operands of a binary expression
+        uint8_t types = 0;
+        // The only function called by a call. It's only compared against and
+        // never dereferenced, since it may have been destroyed since
+        const void *target = nullptr;
+        bool polymorphic = false;
+    };
+
+    std::unordered_map<const Expr *, Site> sites;
+
+    void record(const Binary &b, const std::any &left, const std::any &right);
+
+    void record(const Call &c, const std::any &callee);
+
+    // Whether the binary expression has been run and only seen numbers
+    bool only_floats(const Binary &b) const;
+
+    // The function called by the call if it's always called the same one,
+    // otherwise nullptr
+    const void *target(const Call &c) const;
+};
@@ -4,8 +4,7 @@
 #include <iterator>
 #include <stdexcept>
 #include <string>
-
-bool had_error = false;
+#include "rope.h"
 
 std::string get_file_content(const std::string &fname)
 {
@@ -16,27 +15,6 @@ std::string get_file_content(const std::string &fname)
     return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
 }
 
-void report(int line, const std::string &where, const std::string &msg)
-{
-    std::cerr << "[line " << line << "] Error " << where << ": " << msg << "\n";
-}
-
-void error(int line, const std::string &msg)
-{
-    had_error = true;
-    report(line, "", msg);
-}
-
-void error(const Token &t, const std::string &msg)
-{
-    had_error = true;
-    if (t.type == TokenType::END_OF_FILE) {
-        report(t.line, " at end of file", msg);
-    } else {
-        report(t.line, " at '" + t.lexeme + "'", msg);
-    }
-}
-
 std::string pretty_type_name(const std::any &t)
 {
     return pretty_type_name(t.type());
@@ -47,7 +25,7 @@ std::string pretty_type_name(const std::type_info &t)
     if (t == typeid(float)) {
         return "float";
     }
-    if (t == typeid(std::string)) {
+    if (t == typeid(std::string) || t == typeid(std::shared_ptr<Rope>)) {
         return "string";
     }
     if (t == typeid(bool)) {
@@ -4,6 +4,8 @@ import sys
 import os
 import subprocess
 import glob
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
 
 ANSI_RED = "\033[91m"
 ANSI_GREEN = "\033[92m"
@@ -12,24 +14,128 @@ ANSI_END = "\033[0m"
 test_dir = os.getenv("TEST_DIR")
 failed_tests = 0
 ran_tests = 0
-for test_input in glob.glob("{}/*.lox".format(test_dir)):
+
+
+def check(name, command, expect_output):
+    global failed_tests, ran_tests
+    print("Running test '{}':".format(name), end=" ")
+    ran_tests += 1
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    output = result.stdout.decode("utf-8")
+    if expect_output != output:
+        failed_tests += 1
+        print(ANSI_RED + "Failed" + ANSI_END)
+        print("Expected:\n{}\n----".format(expect_output))
+        print("Got output:\n{}\n----".format(output))
+        print("Stderr:\n{}\n----".format(result.stderr.decode("utf-8")))
+    else:
+        print(ANSI_GREEN + "Passed" + ANSI_END)
+
+
+def expected(test_input):
     script_name = os.path.basename(test_input)
     expect_out_file = "{}/expect/{}.expect".format(test_dir, script_name)
-    print("Running test '{}':".format(script_name), end=" ")
     with open(expect_out_file, "r") as expect_file:
-        ran_tests += 1
-        expect_output = expect_file.read()
-        result = subprocess.run(["./interpreter", test_input], stdout=subprocess.PIPE,
-                stderr=subprocess.PIPE)
-        output = result.stdout.decode("utf-8")
-        if expect_output != output:
-            failed_tests += 1
-            print(ANSI_RED + "Failed" + ANSI_END)
-            print("Expected:\n{}\n----".format(expect_output))
-            print("Got output:\n{}\n----".format(output))
-            print("Stderr:\n{}\n----".format(result.stderr.decode("utf-8")))
-        else:
-            print(ANSI_GREEN + "Passed" + ANSI_END)
+        return expect_file.read()
+
+
+# Extra interpreter flags a test is run with, from args/<test>.args
+def interpreter_args(test_input):
+    script_name = os.path.basename(test_input)
+    args_file = "{}/args/{}.args".format(test_dir, script_name)
+    if not os.path.exists(args_file):
+        return []
+    with open(args_file, "r") as f:
+        return f.read().split()
+
+
+# The ANTLR interpreter built from antlr4-interpreter/ runs the same tests, but
+# doesn't take the hand-written interpreter's flags
+def built_from_antlr():
+    try:
+        with open("CMakeCache.txt", "r") as cache:
+            for line in cache:
+                if line.startswith("CMAKE_HOME_DIRECTORY:"):
+                    source_dir = line.strip().split("=", 1)[1]
+                    return os.path.basename(source_dir) == "antlr4-interpreter"
+    except OSError:
+        pass
+    return False
+
+
+antlr = built_from_antlr()
+tests = sorted(glob.glob("{}/*.lox".format(test_dir)))
+
+# Compiled programs are only cached in a directory of our own, never the user's
+cache_dir = tempfile.TemporaryDirectory()
+os.environ["LOX_CACHE_DIR"] = cache_dir.name
+
+if antlr:
+    # The default front-end visits a parse tree, the others build the AST from
+    # parse events or lex with the generated lexer, and must print the same output
+    for flags in [[], ["--parse-events"], ["--antlr-lexer"], ["--parse-events", "--antlr-lexer"]]:
+        for test_input in tests:
+            name = " ".join([flag[2:] for flag in flags] + [os.path.basename(test_input)])
+            check(name, ["./interpreter"] + flags + [test_input], expected(test_input))
+else:
+    # The scanner, parser and resolver run on every test, rather than loading
+    # programs cached by an earlier run
+    for test_input in tests:
+        check(os.path.basename(test_input),
+              ["./interpreter", "--no-cache"] + interpreter_args(test_input) + [test_input],
+              expected(test_input))
+
+    # Each test runs twice with the cache, compiling and storing the program and
+    # then loading it
+    for test_input in tests:
+        for run in ["cache store ", "cache load "]:
+            check(run + os.path.basename(test_input),
+                  ["./interpreter"] + interpreter_args(test_input) + [test_input],
+                  expected(test_input))
+
+    # Streaming execution runs the same declarations, so prints the same output
+    for test_input in tests:
+        check("stream " + os.path.basename(test_input),
+              ["./interpreter", "--stream"] + interpreter_args(test_input) + [test_input],
+              expected(test_input))
+
+# When the build has loxc, the tests are also compiled to native executables
+# which must print the same output
+if not antlr and os.path.exists("./loxc"):
+    with tempfile.TemporaryDirectory() as build_dir:
+        def build(test_input):
+            exe = os.path.join(build_dir, os.path.basename(test_input)[:-len(".lox")])
+            result = subprocess.run(["./loxc", test_input, "-o", exe], stdout=subprocess.PIPE,
+                    stderr=subprocess.STDOUT)
+            return exe, result
+
+        with ThreadPoolExecutor(max_workers=os.cpu_count()) as pool:
+            builds = list(pool.map(build, tests))
+
+        for test_input, (exe, result) in zip(tests, builds):
+            name = "loxc " + os.path.basename(test_input)
+            if result.returncode != 0:
+                failed_tests += 1
+                ran_tests += 1
+                print("Running test '{}': {}Failed{}".format(name, ANSI_RED, ANSI_END))
+                print("Build output:\n{}\n----".format(result.stdout.decode("utf-8")))
+                continue
+            check(name, [exe], expected(test_input))
+
+# The C++ tests of liblox built alongside the interpreter, which report their own
+# failures and exit non-zero
+for test_exe in sorted(glob.glob("./*_test")):
+    print("Running test '{}':".format(os.path.basename(test_exe)), end=" ")
+    ran_tests += 1
+    result = subprocess.run([test_exe], stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    if result.returncode != 0:
+        failed_tests += 1
+        print(ANSI_RED + "Failed" + ANSI_END)
+        print("Output:\n{}\n----".format(result.stdout.decode("utf-8")))
+    else:
+        print(ANSI_GREEN + "Passed" + ANSI_END)
+
+cache_dir.cleanup()
 
 print("Ran {} tests".format(ran_tests))
 
@@ -38,4 +144,3 @@ if failed_tests != 0:
     sys.exit(1)
 else:
     print("All tests passed")
-